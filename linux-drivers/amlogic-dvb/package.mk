@@ -111,6 +111,23 @@ EOF
   cat > "$INSTALL/usr/bin/amlogic-dvb-init.sh" <<'EOF'
 #!/bin/bash
 sleep 2
+
+# Apply amlogic-dvb.conf to the live adapter (no module reload needed)
+CONF=/storage/.config/amlogic-dvb.conf
+[ -f "$CONF" ] || CONF=/usr/config/amlogic-dvb.conf
+for d in /sys/bus/platform/drivers/aml_dvb/*; do
+  [ -e "$d/dma_buffer_kb" ] && SYSFS="$d"
+done
+if [ -f "$CONF" ] && [ -n "$SYSFS" ]; then
+  . "$CONF"
+  [ -n "$DMA_BUFFER_SIZE" ] && echo "$DMA_BUFFER_SIZE" > "$SYSFS/dma_buffer_kb"
+  [ -n "$IRQ_COALESCE" ] && echo "$IRQ_COALESCE" > "$SYSFS/irq_coalesce_us"
+  [ -n "$MAX_LATENCY_MS" ] && echo "$MAX_LATENCY_MS" > "$SYSFS/max_latency_ms"
+  [ -n "$DMA_SG" ] && echo "$DMA_SG" > "$SYSFS/dma_sg"
+  # TS_MODE=0 (auto) is left to the driver and its cached detection
+  [ "${TS_MODE:-0}" != 0 ] && echo "$TS_MODE ${TS_CLK_POL:--1}" > "$SYSFS/ts_input"
+fi
+
 if [ -d /dev/dvb/adapter0 ]; then
   echo "DVB OK: /dev/dvb/adapter0"
   ls -la /dev/dvb/adapter0/
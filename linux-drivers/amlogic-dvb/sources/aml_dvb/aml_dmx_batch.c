@@ -0,0 +1,450 @@
+// sources/aml_dvb/aml_dmx_batch.c
+// Batched filter setup - many PID/section filters in one call
+//
+// Scans and EPG grabs otherwise open one demux fd per filter and pay a
+// syscall plus a PID table commit for each DMX_START. Here one ioctl
+// installs an array of filters on the primary demux while the PID set
+// is held, so the hardware table is reprogrammed once for the batch.
+// Output of all filters of an open file is multiplexed on read() as
+// records tagged with the filter handle. Records that did not fit the
+// buffer are reported like a dvr overflow: the next read() fails with
+// -EOVERFLOW (poll() flags EPOLLERR), then reading continues.
+
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/miscdevice.h>
+#include <linux/poll.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <media/dvb_ringbuffer.h>
+#include "aml_dvb.h"
+
+#define AML_DMX_BATCH_BUFSZ (256 * 1024)
+
+struct aml_dmx_batch_file;
+
+struct aml_dmx_batch_filter {
+    struct aml_dmx_batch_file *bf;
+    int handle;
+    u8 type;
+    union {
+        struct dmx_section_feed *sec;
+        struct dmx_ts_feed *ts;
+    } feed;
+    struct dmx_section_filter *filter;
+};
+
+struct aml_dmx_batch_file {
+    struct aml_dvb *dvb;
+    struct mutex mutex;             /* filters and reader side */
+    struct dvb_ringbuffer buffer;   /* written under demux->lock */
+    u32 dropped;                    /* since the last -EOVERFLOW */
+    struct aml_dmx_batch_filter *filters[AML_DMX_BATCH_MAX];
+};
+
+// Queue one record; callbacks of a demux never run concurrently
+static int aml_dmx_batch_put(struct aml_dmx_batch_filter *f,
+                             const u8 *buf1, size_t len1,
+                             const u8 *buf2, size_t len2)
+{
+    struct aml_dmx_batch_file *bf = f->bf;
+    struct aml_dmx_batch_event ev = {
+        .handle = f->handle,
+        .len = len1 + len2,
+    };
+
+    if (dvb_ringbuffer_free(&bf->buffer) < sizeof(ev) + ev.len) {
+        WRITE_ONCE(bf->dropped, bf->dropped + 1);
+        wake_up_interruptible(&bf->buffer.queue);
+        return 0;
+    }
+
+    dvb_ringbuffer_write(&bf->buffer, (u8 *)&ev, sizeof(ev));
+    dvb_ringbuffer_write(&bf->buffer, buf1, len1);
+    if (len2)
+        dvb_ringbuffer_write(&bf->buffer, buf2, len2);
+
+    wake_up_interruptible(&bf->buffer.queue);
+    return 0;
+}
+
+static int aml_dmx_batch_sec_cb(const u8 *buffer1, size_t buffer1_len,
+                                const u8 *buffer2, size_t buffer2_len,
+                                struct dmx_section_filter *source,
+                                u32 *buffer_flags)
+{
+    return aml_dmx_batch_put(source->priv, buffer1, buffer1_len,
+                             buffer2, buffer2_len);
+}
+
+static int aml_dmx_batch_ts_cb(const u8 *buffer1, size_t buffer1_len,
+                               const u8 *buffer2, size_t buffer2_len,
+                               struct dmx_ts_feed *source, u32 *buffer_flags)
+{
+    return aml_dmx_batch_put(source->priv, buffer1, buffer1_len,
+                             buffer2, buffer2_len);
+}
+
+static int aml_dmx_batch_open_sec(struct aml_dmx_batch_filter *f,
+                                  struct dmx_demux *dmx,
+                                  const struct aml_dmx_batch_spec *spec)
+{
+    struct dmx_section_feed *feed;
+    int i, ret;
+
+    ret = dmx->allocate_section_feed(dmx, &f->feed.sec, aml_dmx_batch_sec_cb);
+    if (ret < 0)
+        return ret;
+    feed = f->feed.sec;
+
+    ret = feed->set(feed, spec->pid, spec->flags & AML_DMX_BATCH_CRC);
+    if (ret < 0)
+        goto err_feed;
+
+    ret = feed->allocate_filter(feed, &f->filter);
+    if (ret < 0)
+        goto err_feed;
+
+    // Same layout as DMX_SET_FILTER: byte 0, then section bytes 3..;
+    // bytes 1-2 are section_length. Mode is inverted as in dmxdev.
+    memset(f->filter->filter_value, 0, DMX_MAX_FILTER_SIZE);
+    memset(f->filter->filter_mask, 0, DMX_MAX_FILTER_SIZE);
+    memset(f->filter->filter_mode, 0xFF, DMX_MAX_FILTER_SIZE);
+    for (i = 0; i < DMX_FILTER_SIZE; i++) {
+        int b = i ? i + 2 : 0;
+
+        f->filter->filter_value[b] = spec->filter[i];
+        f->filter->filter_mask[b] = spec->mask[i];
+        f->filter->filter_mode[b] = spec->mode[i] ^ 0xFF;
+    }
+    f->filter->priv = f;
+    if (spec->flags & AML_DMX_BATCH_DEDUP)
+        f->filter->flags |= DMX_DELIVER_ON_CHANGE;
+
+    ret = feed->start_filtering(feed);
+    if (ret < 0)
+        goto err_filter;
+
+    return 0;
+
+err_filter:
+    feed->release_filter(feed, f->filter);
+err_feed:
+    dmx->release_section_feed(dmx, feed);
+    return ret;
+}
+
+static int aml_dmx_batch_open_ts(struct aml_dmx_batch_filter *f,
+                                 struct dmx_demux *dmx,
+                                 const struct aml_dmx_batch_spec *spec)
+{
+    struct dmx_ts_feed *feed;
+    int ret;
+
+    ret = dmx->allocate_ts_feed(dmx, &f->feed.ts, aml_dmx_batch_ts_cb);
+    if (ret < 0)
+        return ret;
+    feed = f->feed.ts;
+    feed->priv = f;
+
+    ret = feed->set(feed, spec->pid, TS_PACKET, DMX_PES_OTHER, 0);
+    if (ret < 0)
+        goto err_feed;
+
+    ret = feed->start_filtering(feed);
+    if (ret < 0)
+        goto err_feed;
+
+    return 0;
+
+err_feed:
+    dmx->release_ts_feed(dmx, feed);
+    return ret;
+}
+
+static void aml_dmx_batch_close(struct aml_dmx_batch_file *bf, int handle)
+{
+    struct aml_dmx_batch_filter *f = bf->filters[handle];
+    struct dmx_demux *dmx = &bf->dvb->demux.dmx;
+
+    if (!f)
+        return;
+
+    if (f->type == AML_DMX_BATCH_SECTION) {
+        f->feed.sec->stop_filtering(f->feed.sec);
+        f->feed.sec->release_filter(f->feed.sec, f->filter);
+        dmx->release_section_feed(dmx, f->feed.sec);
+    } else {
+        f->feed.ts->stop_filtering(f->feed.ts);
+        dmx->release_ts_feed(dmx, f->feed.ts);
+    }
+
+    bf->filters[handle] = NULL;
+    kfree(f);
+}
+
+static int aml_dmx_batch_add_one(struct aml_dmx_batch_file *bf,
+                                 const struct aml_dmx_batch_spec *spec)
+{
+    struct dmx_demux *dmx = &bf->dvb->demux.dmx;
+    struct aml_dmx_batch_filter *f;
+    int handle, ret;
+
+    if (spec->pid > 0x1FFF || spec->type > AML_DMX_BATCH_TS)
+        return -EINVAL;
+
+    for (handle = 0; handle < AML_DMX_BATCH_MAX; handle++)
+        if (!bf->filters[handle])
+            break;
+    if (handle == AML_DMX_BATCH_MAX)
+        return -EMFILE;
+
+    f = kzalloc(sizeof(*f), GFP_KERNEL);
+    if (!f)
+        return -ENOMEM;
+
+    f->bf = bf;
+    f->handle = handle;
+    f->type = spec->type;
+
+    if (spec->type == AML_DMX_BATCH_SECTION)
+        ret = aml_dmx_batch_open_sec(f, dmx, spec);
+    else
+        ret = aml_dmx_batch_open_ts(f, dmx, spec);
+    if (ret < 0) {
+        kfree(f);
+        return ret;
+    }
+
+    bf->filters[handle] = f;
+    return handle;
+}
+
+// Install every spec; per-filter results go back in spec->result
+static long aml_dmx_batch_add(struct aml_dmx_batch_file *bf,
+                              struct aml_dmx_batch *req)
+{
+    struct aml_dmx_batch_spec __user *uspecs = u64_to_user_ptr(req->ptr);
+    struct aml_dmx_batch_spec *specs;
+    int i, ok = 0, ret;
+
+    if (!req->count || req->count > AML_DMX_BATCH_MAX)
+        return -EINVAL;
+
+    specs = memdup_user(uspecs, req->count * sizeof(*specs));
+    if (IS_ERR(specs))
+        return PTR_ERR(specs);
+
+    aml_dvb_pidset_hold(bf->dvb);
+    for (i = 0; i < req->count; i++) {
+        specs[i].result = aml_dmx_batch_add_one(bf, &specs[i]);
+        if (specs[i].result >= 0)
+            ok++;
+    }
+    ret = aml_dvb_pidset_release(bf->dvb);
+
+    if (copy_to_user(uspecs, specs, req->count * sizeof(*specs)))
+        ret = -EFAULT;
+    kfree(specs);
+
+    return ret ? ret : ok;
+}
+
+static long aml_dmx_batch_del(struct aml_dmx_batch_file *bf,
+                              struct aml_dmx_batch *req)
+{
+    s32 *handles;
+    int i;
+
+    if (!req->count || req->count > AML_DMX_BATCH_MAX)
+        return -EINVAL;
+
+    handles = memdup_user(u64_to_user_ptr(req->ptr),
+                          req->count * sizeof(*handles));
+    if (IS_ERR(handles))
+        return PTR_ERR(handles);
+
+    // Stops are folded into one deferred PID set commit anyway
+    for (i = 0; i < req->count; i++)
+        if (handles[i] >= 0 && handles[i] < AML_DMX_BATCH_MAX)
+            aml_dmx_batch_close(bf, handles[i]);
+
+    kfree(handles);
+    return 0;
+}
+
+static long aml_dmx_batch_ioctl(struct file *file, unsigned int cmd,
+                                unsigned long arg)
+{
+    struct aml_dmx_batch_file *bf = file->private_data;
+    struct aml_dmx_batch req;
+    long ret;
+
+    if (cmd != AML_DMX_BATCH_ADD && cmd != AML_DMX_BATCH_DEL)
+        return -ENOTTY;
+
+    if (copy_from_user(&req, (void __user *)arg, sizeof(req)))
+        return -EFAULT;
+
+    mutex_lock(&bf->mutex);
+    if (cmd == AML_DMX_BATCH_ADD)
+        ret = aml_dmx_batch_add(bf, &req);
+    else
+        ret = aml_dmx_batch_del(bf, &req);
+    mutex_unlock(&bf->mutex);
+
+    return ret;
+}
+
+// Whole records only; at least one record must fit in @count
+static ssize_t aml_dmx_batch_read(struct file *file, char __user *buf,
+                                  size_t count, loff_t *ppos)
+{
+    struct aml_dmx_batch_file *bf = file->private_data;
+    struct dvb_ringbuffer *rb = &bf->buffer;
+    struct aml_dmx_batch_event ev;
+    size_t done = 0, need = sizeof(ev), rec;
+    bool too_big = false;
+    int i, ret;
+
+again:
+    ret = wait_event_interruptible(rb->queue,
+                                   (file->f_flags & O_NONBLOCK) ||
+                                   dvb_ringbuffer_avail(rb) >= need ||
+                                   READ_ONCE(bf->dropped));
+    if (ret)
+        return ret;
+
+    if (xchg(&bf->dropped, 0))
+        return -EOVERFLOW;
+
+    mutex_lock(&bf->mutex);
+    while (dvb_ringbuffer_avail(rb) >= sizeof(ev)) {
+        for (i = 0; i < sizeof(ev); i++)
+            ((u8 *)&ev)[i] = DVB_RINGBUFFER_PEEK(rb, i);
+
+        rec = sizeof(ev) + ev.len;
+        if (done + rec > count) {
+            too_big = true;
+            break;
+        }
+
+        // aml_dmx_batch_put() may still be writing the payload
+        if (dvb_ringbuffer_avail(rb) < rec) {
+            need = rec;
+            break;
+        }
+
+        if (dvb_ringbuffer_read_user(rb, buf + done, rec) != rec) {
+            ret = -EFAULT;
+            break;
+        }
+        done += rec;
+    }
+    mutex_unlock(&bf->mutex);
+
+    if (done)
+        return done;
+    if (ret)
+        return ret;
+    if (too_big)
+        return -EINVAL;     /* next record does not fit */
+    if (file->f_flags & O_NONBLOCK)
+        return -EWOULDBLOCK;
+    goto again;             /* record still being queued */
+}
+
+static __poll_t aml_dmx_batch_poll(struct file *file, poll_table *wait)
+{
+    struct aml_dmx_batch_file *bf = file->private_data;
+
+    __poll_t mask = 0;
+
+    poll_wait(file, &bf->buffer.queue, wait);
+
+    if (!dvb_ringbuffer_empty(&bf->buffer))
+        mask |= EPOLLIN | EPOLLRDNORM;
+    if (READ_ONCE(bf->dropped))
+        mask |= EPOLLERR;
+    return mask;
+}
+
+static int aml_dmx_batch_open(struct inode *inode, struct file *file)
+{
+    struct aml_dmx_batch_dev *dev = container_of(file->private_data,
+                                                 struct aml_dmx_batch_dev,
+                                                 misc);
+    struct aml_dmx_batch_file *bf;
+    void *mem;
+
+    bf = kzalloc(sizeof(*bf), GFP_KERNEL);
+    if (!bf)
+        return -ENOMEM;
+
+    mem = vmalloc(AML_DMX_BATCH_BUFSZ);
+    if (!mem) {
+        kfree(bf);
+        return -ENOMEM;
+    }
+
+    bf->dvb = dev->dvb;
+    mutex_init(&bf->mutex);
+    dvb_ringbuffer_init(&bf->buffer, mem, AML_DMX_BATCH_BUFSZ);
+
+    file->private_data = bf;
+    return nonseekable_open(inode, file);
+}
+
+static int aml_dmx_batch_release(struct inode *inode, struct file *file)
+{
+    struct aml_dmx_batch_file *bf = file->private_data;
+    int i;
+
+    mutex_lock(&bf->mutex);
+    for (i = 0; i < AML_DMX_BATCH_MAX; i++)
+        aml_dmx_batch_close(bf, i);
+    mutex_unlock(&bf->mutex);
+
+    vfree(bf->buffer.data);
+    kfree(bf);
+    return 0;
+}
+
+static const struct file_operations aml_dmx_batch_fops = {
+    .owner = THIS_MODULE,
+    .open = aml_dmx_batch_open,
+    .release = aml_dmx_batch_release,
+    .read = aml_dmx_batch_read,
+    .poll = aml_dmx_batch_poll,
+    .unlocked_ioctl = aml_dmx_batch_ioctl,
+    .compat_ioctl = compat_ptr_ioctl,
+    .llseek = noop_llseek,
+};
+
+int aml_dmx_batch_init(struct aml_dvb *dvb)
+{
+    struct aml_dmx_batch_dev *dev = &dvb->batch;
+
+    dev->dvb = dvb;
+    snprintf(dev->name, sizeof(dev->name), "aml-dvb%d-batch",
+             dvb->adapter.num);
+    dev->misc.minor = MISC_DYNAMIC_MINOR;
+    dev->misc.name = dev->name;
+    dev->misc.fops = &aml_dmx_batch_fops;
+    dev->misc.parent = dvb->dev;
+
+    return misc_register(&dev->misc);
+}
+EXPORT_SYMBOL(aml_dmx_batch_init);
+
+void aml_dmx_batch_exit(struct aml_dvb *dvb)
+{
+    if (dvb->batch.dvb)
+        misc_deregister(&dvb->batch.misc);
+    dvb->batch.dvb = NULL;
+}
+EXPORT_SYMBOL(aml_dmx_batch_exit);
+
+MODULE_DESCRIPTION("Amlogic DVB Batched Filter Setup");
+MODULE_LICENSE("GPL");
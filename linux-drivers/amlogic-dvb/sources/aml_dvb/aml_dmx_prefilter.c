@@ -0,0 +1,228 @@
+// sources/aml_dvb/aml_dmx_prefilter.c
+// Receive pre-filter between the DMA rings and dvb-core
+//
+// Unused hardware PID slots hold 0x1FFF, so null padding reaches the
+// ring along with the wanted PIDs; on a weak satellite signal so do
+// packets with transport_error_indicator set, and some muxes repeat
+// packets (same CC, same bytes). All of them went through the full
+// software demux. Here they are dropped before dvb-core sees them: the
+// ring is scanned in place and the runs of kept packets between drops
+// are handed to dvb_dmx_swfilter_packets(), nothing is copied.
+//
+// A continuity counter is tracked per PID. A packet repeating the last
+// CC is compared with the previous packet of its PID, if that is still
+// in the chunk being filtered, and only dropped when bytes 3..187 match;
+// nothing is hashed for packets whose CC advances. A repeat whose
+// original came in an earlier chunk goes to dvb-core as before. A
+// dropped TEI packet leaves a real gap in its PID's CC sequence, and
+// that gap still reaches the feeds: dvb-core flags the discontinuity
+// just as before. Gaps are counted per PID here as well.
+
+#include <linux/module.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sysfs.h>
+#include <media/dvb_demux.h>
+#include "aml_dvb.h"
+
+#define AML_DMX_PF_PIDS         0x1FFF
+
+// Nulls only by default: TEI packets and repeats still carry data some
+// consumers want (error concealment, analysers), so those are opt-in
+static unsigned int prefilter = AML_DMX_PF_NULL;
+module_param(prefilter, uint, 0644);
+MODULE_PARM_DESC(prefilter,
+                 "Drop before the software demux: 1 = null packets (default), 2 = TEI packets, 4 = duplicates (0 = off)");
+
+int aml_dmx_prefilter_init(struct aml_dmx_prefilter *pf)
+{
+    pf->pid = vzalloc(array_size(AML_DMX_PF_PIDS, sizeof(*pf->pid)));
+    if (!pf->pid)
+        return -ENOMEM;
+
+    atomic_set(&pf->keep_nulls, 0);
+    pf->gen = 0;
+    return 0;
+}
+EXPORT_SYMBOL(aml_dmx_prefilter_init);
+
+void aml_dmx_prefilter_exit(struct aml_dmx_prefilter *pf)
+{
+    vfree(pf->pid);
+    pf->pid = NULL;
+}
+EXPORT_SYMBOL(aml_dmx_prefilter_exit);
+
+// Forget CC state and counters; called with the ring's DMA lock held
+void aml_dmx_prefilter_reset(struct aml_dmx_prefilter *pf)
+{
+    if (pf->pid)
+        memset(pf->pid, 0, array_size(AML_DMX_PF_PIDS, sizeof(*pf->pid)));
+
+    pf->packets = 0;
+    pf->passed = 0;
+    pf->nulls = 0;
+    pf->tei = 0;
+    pf->dups = 0;
+    pf->cc_errors = 0;
+    pf->runs = 0;
+    pf->ns = 0;
+}
+EXPORT_SYMBOL(aml_dmx_prefilter_reset);
+
+// Full-TS (0x2000) feeds record the mux as sent, padding included, and
+// a feed on the null PID asked for the padding itself: either keeps
+// nulls. A new PID feed starts its CC check afresh; the state may be
+// from an earlier tune.
+void aml_dmx_prefilter_feed(struct aml_dmx_prefilter *pf,
+                            struct dvb_demux_feed *feed, bool start)
+{
+    bool nulls = feed->pid == 0x1FFF || feed->pid == 0x2000;
+
+    if (start && pf->pid && feed->pid < AML_DMX_PF_PIDS)
+        WRITE_ONCE(pf->pid[feed->pid].seen, false);
+
+    if (!nulls || feed->type != DMX_TYPE_TS)
+        return;
+
+    if (start)
+        atomic_inc(&pf->keep_nulls);
+    else
+        atomic_dec(&pf->keep_nulls);
+}
+EXPORT_SYMBOL(aml_dmx_prefilter_feed);
+
+// True if packet @i of @buf is dropped; CC bookkeeping for the rest
+static bool aml_dmx_prefilter_drop(struct aml_dmx_prefilter *pf, const u8 *buf,
+                                   unsigned int i, unsigned int mask)
+{
+    const u8 *p = buf + i * TS_PACKET_SIZE;
+    struct aml_dmx_pf_pid *s;
+    unsigned int pid, afc, cc;
+    bool disc;
+
+    // Lost sync: dvb-core resynchronizes and counts it
+    if (p[0] != 0x47)
+        return false;
+
+    // The PID of a TEI packet cannot be trusted, keep it out of the state
+    if (p[1] & 0x80) {
+        pf->tei++;
+        return mask & AML_DMX_PF_TEI;
+    }
+
+    pid = (p[1] & 0x1f) << 8 | p[2];
+    if (pid == 0x1FFF) {
+        pf->nulls++;
+        return mask & AML_DMX_PF_NULL;
+    }
+
+    // Adaptation field only: CC does not advance
+    afc = (p[3] >> 4) & 3;
+    if (!(afc & 1))
+        return false;
+
+    s = &pf->pid[pid];
+    cc = p[3] & 0x0f;
+    disc = afc == 3 && p[4] && (p[5] & 0x80);
+
+    if (s->seen && !disc && cc != ((s->cc + 1) & 0x0f)) {
+        if (cc == s->cc && (mask & AML_DMX_PF_DUP) &&
+            s->gen == pf->gen && s->idx < i &&
+            !memcmp(buf + s->idx * TS_PACKET_SIZE + 3, p + 3,
+                    TS_PACKET_SIZE - 3)) {
+            pf->dups++;
+            return true;
+        }
+
+        s->cc_errors++;
+        pf->cc_errors++;
+    }
+
+    s->cc = cc;
+    s->gen = pf->gen;
+    s->idx = i;
+    s->seen = true;
+    return false;
+}
+
+/*
+ * Hand @count packets at @buf to @demux, minus the ones the mask drops.
+ * Runs under the ring's DMA lock; the kept packets stay where they are,
+ * so decoder runs and arrival timestamps still refer to the ring.
+ */
+void aml_dmx_prefilter(struct aml_dmx_prefilter *pf, struct dvb_demux *demux,
+                       const u8 *buf, unsigned int count)
+{
+    unsigned int mask = READ_ONCE(prefilter);
+    unsigned int i, start = 0, passed = 0;
+    ktime_t t = ktime_get();
+
+    if (!pf->pid) {
+        dvb_dmx_swfilter_packets(demux, buf, count);
+        return;
+    }
+
+    if (atomic_read(&pf->keep_nulls))
+        mask &= ~AML_DMX_PF_NULL;
+
+    // Packets of earlier calls may have been overwritten by DMA since
+    pf->gen++;
+
+    for (i = 0; i < count; i++) {
+        if (!aml_dmx_prefilter_drop(pf, buf, i, mask))
+            continue;
+
+        if (i > start) {
+            dvb_dmx_swfilter_packets(demux, buf + start * TS_PACKET_SIZE,
+                                     i - start);
+            passed += i - start;
+            pf->runs++;
+        }
+        start = i + 1;
+    }
+
+    if (count > start) {
+        dvb_dmx_swfilter_packets(demux, buf + start * TS_PACKET_SIZE,
+                                 count - start);
+        passed += count - start;
+        pf->runs++;
+    }
+
+    pf->packets += count;
+    pf->passed += passed;
+    pf->ns += ktime_to_ns(ktime_sub(ktime_get(), t));
+}
+EXPORT_SYMBOL(aml_dmx_prefilter);
+
+// Counters of one ring, then the PIDs that had CC gaps, appended at @len
+ssize_t aml_dmx_prefilter_show(struct aml_dmx_prefilter *pf, const char *name,
+                               char *buf, ssize_t len)
+{
+    unsigned int pid;
+
+    len += sysfs_emit_at(buf, len,
+                         "%s packets=%llu passed=%llu nulls=%llu tei=%llu dups=%llu cc_errors=%llu runs=%llu ns_per_packet=%llu\n",
+                         name, pf->packets, pf->passed, pf->nulls, pf->tei,
+                         pf->dups, pf->cc_errors, pf->runs,
+                         pf->packets ? div64_u64(pf->ns, pf->packets) : 0);
+
+    if (!pf->pid)
+        return len;
+
+    for (pid = 0; pid < AML_DMX_PF_PIDS; pid++) {
+        if (!pf->pid[pid].cc_errors)
+            continue;
+        if (len > PAGE_SIZE - 64)
+            break;
+        len += sysfs_emit_at(buf, len, "%s pid=%u cc_errors=%u\n", name, pid,
+                             pf->pid[pid].cc_errors);
+    }
+
+    return len;
+}
+EXPORT_SYMBOL(aml_dmx_prefilter_show);
+
+MODULE_DESCRIPTION("Amlogic DVB Receive Pre-filter");
+MODULE_LICENSE("GPL");
@@ -1,24 +1,593 @@
 // sources/aml_dvb/aml_dmx_section.c
 // Section demux handling
+//
+// Section feeds are routed through aml_dmx_section_cb() on their way to
+// dmxdev. The latest CRC-valid PAT, PMT, NIT and SDT sections of the
+// current transport stream are kept so a newly started filter is answered
+// from the cache immediately instead of waiting for the next repetition.
+// The cache is emptied on every retune, on loss of lock, on a TS input
+// change and when the stream restarts after runtime suspend.
+//
+// A filter can ask for "deliver only on change" with DMX_DELIVER_ON_CHANGE
+// (patches/005): a section whose table_id/extension/section_number/
+// version/CRC that filter has already seen is dropped here instead of
+// waking the reader (EIT repeats). Other filters on the PID get every
+// copy as usual.
+//
+// With hw_crc the demux checks section CRC32 on PIDs flagged in the PID
+// table and queues a verdict per section, tagged with the PID and the
+// low half of the section's CRC_32 field. dvb-core's CRC check takes a
+// verdict only when it matches the section in hand and no other verdict
+// in the window disagrees; anything uncertain is checked with crc32_be().
 
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/crc32.h>
+#include <linux/hashtable.h>
+#include <linux/jhash.h>
 #include "aml_dvb.h"
 
-static void aml_dmx_section_cb(const u8 *buffer, size_t len, void *priv)
+#define AML_DMX_SEC_CACHE_MAX   128
+
+static bool hw_crc = true;
+module_param(hw_crc, bool, 0444);
+MODULE_PARM_DESC(hw_crc, "Use the demux hardware to check section CRC32");
+
+static unsigned int section_dedup_max = 8192;
+module_param(section_dedup_max, uint, 0644);
+MODULE_PARM_DESC(section_dedup_max,
+                 "Maximum sections tracked for deduplication");
+
+struct aml_dmx_sec_entry {
+    struct list_head list;
+    u16 pid;
+    u8 table_id;
+    u16 ext;
+    u8 section_number;
+    u8 version;
+    u32 crc;
+    size_t len;
+    u8 data[];
+};
+
+struct aml_dmx_dedup_entry {
+    struct hlist_node node;
+    u16 filter;                 /* dvb_demux_filter index */
+    u8 table_id;
+    u8 section_number;
+    u16 ext;
+    u16 tsid;                   /* EIT only: transport_stream_id */
+    u16 onid;                   /* EIT only: original_network_id */
+    u8 version;
+    u32 crc;
+};
+
+static inline u16 aml_dmx_sec_ext(const u8 *sec)
+{
+    return (sec[3] << 8) | sec[4];
+}
+
+static inline u32 aml_dmx_sec_crc(const u8 *sec, size_t len)
+{
+    return (sec[len - 4] << 24) | (sec[len - 3] << 16) |
+           (sec[len - 2] << 8) | sec[len - 1];
+}
+
+// PAT, PMT, NIT actual and SDT actual
+static bool aml_dmx_section_cacheable(u16 pid, u8 table_id)
+{
+    switch (table_id) {
+    case 0x00:
+        return pid == 0x0000;
+    case 0x02:
+        return true;
+    case 0x40:
+        return pid == 0x0010;
+    case 0x42:
+        return pid == 0x0011;
+    default:
+        return false;
+    }
+}
+
+static void aml_dmx_section_cache_flush_locked(struct aml_dmx_sec_cache *cache)
+{
+    struct aml_dmx_sec_entry *e, *tmp;
+
+    list_for_each_entry_safe(e, tmp, &cache->entries, list) {
+        list_del(&e->list);
+        kfree(e);
+    }
+    cache->count = 0;
+    cache->tsid = -1;
+}
+
+static void aml_dmx_section_dedup_forget(struct aml_dvb *dvb, int filter);
+
+// Retune or new stream: drop the cache and what dedup has seen
+void aml_dmx_section_cache_flush(struct aml_dvb *dvb)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&dvb->sec_cache.lock, flags);
+    aml_dmx_section_cache_flush_locked(&dvb->sec_cache);
+    spin_unlock_irqrestore(&dvb->sec_cache.lock, flags);
+
+    aml_dmx_section_dedup_forget(dvb, -1);
+}
+EXPORT_SYMBOL(aml_dmx_section_cache_flush);
+
+// Called from the section callback, under the demux lock
+static void aml_dmx_section_cache_update(struct aml_dvb *dvb, u16 pid,
+                                         const u8 *sec, size_t len)
+{
+    struct aml_dmx_sec_cache *cache = &dvb->sec_cache;
+    struct aml_dmx_sec_entry *e, *tmp, *old = NULL;
+    u8 table_id = sec[0];
+    u16 ext;
+    u8 version, secnum;
+    u32 crc;
+
+    // Long-form, current sections only
+    if (len < 12 || !(sec[1] & 0x80) || !(sec[5] & 0x01))
+        return;
+    if (!aml_dmx_section_cacheable(pid, table_id))
+        return;
+
+    ext = aml_dmx_sec_ext(sec);
+    version = (sec[5] >> 1) & 0x1F;
+    secnum = sec[6];
+    crc = aml_dmx_sec_crc(sec, len);
+
+    spin_lock(&cache->lock);
+
+    // A PAT from a different transport stream invalidates everything
+    if (table_id == 0x00 && cache->tsid != ext) {
+        aml_dmx_section_cache_flush_locked(cache);
+        cache->tsid = ext;
+    }
+
+    list_for_each_entry_safe(e, tmp, &cache->entries, list) {
+        if (e->pid != pid || e->table_id != table_id || e->ext != ext)
+            continue;
+
+        if (e->section_number == secnum) {
+            if (e->version == version && e->crc == crc)
+                goto out;       /* repeat of what we hold */
+            old = e;
+        } else if (e->version != version) {
+            // Other sections of a superseded table version
+            list_del(&e->list);
+            kfree(e);
+            cache->count--;
+        }
+    }
+
+    if (crc32_be(~0, sec, len))
+        goto out;
+
+    if (!old && cache->count >= AML_DMX_SEC_CACHE_MAX)
+        goto out;
+
+    e = kmalloc(struct_size(e, data, len), GFP_ATOMIC);
+    if (!e)
+        goto out;
+
+    e->pid = pid;
+    e->table_id = table_id;
+    e->ext = ext;
+    e->section_number = secnum;
+    e->version = version;
+    e->crc = crc;
+    e->len = len;
+    memcpy(e->data, sec, len);
+
+    if (old) {
+        list_replace(&old->list, &e->list);
+        kfree(old);
+    } else {
+        list_add_tail(&e->list, &cache->entries);
+        cache->count++;
+    }
+out:
+    spin_unlock(&cache->lock);
+}
+
+// Returns true if the filter has already delivered this exact section.
+// Called from the section callback, under the demux lock.
+static bool aml_dmx_section_dedup(struct aml_dvb *dvb, u16 filter,
+                                  const u8 *sec, size_t len)
+{
+    struct aml_dmx_sec_dedup *dd = &dvb->sec_dedup;
+    struct aml_dmx_dedup_entry key = { }, *e;
+    bool repeat = false;
+    u32 hash;
+
+    // Short-form sections (TDT/TOT) carry no version
+    if (len < 12 || !(sec[1] & 0x80)) {
+        dd->delivered++;
+        return false;
+    }
+
+    key.filter = filter;
+    key.table_id = sec[0];
+    key.section_number = sec[6];
+    key.ext = aml_dmx_sec_ext(sec);
+    if (sec[0] >= 0x4E && sec[0] <= 0x6F && len >= 16) {
+        key.tsid = (sec[8] << 8) | sec[9];
+        key.onid = (sec[10] << 8) | sec[11];
+    }
+    key.version = (sec[5] >> 1) & 0x1F;
+    key.crc = aml_dmx_sec_crc(sec, len);
+
+    hash = jhash_3words((key.filter << 16) | (key.table_id << 8) |
+                        key.section_number, key.ext,
+                        (key.tsid << 16) | key.onid, 0);
+
+    spin_lock(&dd->lock);
+    hash_for_each_possible(dd->hash, e, node, hash) {
+        if (e->filter != key.filter || e->table_id != key.table_id ||
+            e->section_number != key.section_number || e->ext != key.ext ||
+            e->tsid != key.tsid || e->onid != key.onid)
+            continue;
+
+        if (e->version == key.version && e->crc == key.crc) {
+            repeat = true;
+        } else {
+            e->version = key.version;
+            e->crc = key.crc;
+        }
+        goto out;
+    }
+
+    // New section: track it if there is room, deliver it either way
+    if (dd->count < section_dedup_max) {
+        e = kmalloc(sizeof(*e), GFP_ATOMIC);
+        if (e) {
+            *e = key;
+            hash_add(dd->hash, &e->node, hash);
+            dd->count++;
+        }
+    }
+out:
+    if (repeat)
+        dd->suppressed++;
+    else
+        dd->delivered++;
+    spin_unlock(&dd->lock);
+
+    return repeat;
+}
+
+// Forget what one filter has seen (all filters for -1)
+static void aml_dmx_section_dedup_forget(struct aml_dvb *dvb, int filter)
+{
+    struct aml_dmx_sec_dedup *dd = &dvb->sec_dedup;
+    struct aml_dmx_dedup_entry *e;
+    struct hlist_node *tmp;
+    unsigned long flags;
+    int bkt;
+
+    spin_lock_irqsave(&dd->lock, flags);
+    if (!dd->count)
+        goto out;
+    hash_for_each_safe(dd->hash, bkt, tmp, e, node) {
+        if (filter >= 0 && e->filter != filter)
+            continue;
+        hash_del(&e->node);
+        kfree(e);
+        dd->count--;
+    }
+out:
+    spin_unlock_irqrestore(&dd->lock, flags);
+}
+
+// PID table flags for a starting feed
+u16 aml_dmx_section_pid_flags(struct aml_dvb *dvb, struct dvb_demux_feed *feed)
+{
+    if (hw_crc && feed->type == DMX_TYPE_SEC && feed->pid <= 0x1FFF &&
+        feed->feed.sec.check_crc)
+        return AML_PID_SEC_CRC;
+
+    return 0;
+}
+EXPORT_SYMBOL(aml_dmx_section_pid_flags);
+
+// Move what the hardware has queued into the verdict window
+static void aml_dmx_section_crc_drain(struct aml_dvb *dvb)
+{
+    struct aml_dmx_crc_verdicts *cv = &dvb->crc_verdicts;
+    struct aml_dmx_crc_verdict *v;
+    u16 pid, tag;
+    bool fail;
+
+    while (!aml_dvb_reg_sec_crc_pop(dvb, &pid, &tag, &fail)) {
+        v = &cv->v[cv->head++ % AML_DMX_CRC_VERDICTS];
+        v->pid = pid;
+        v->tag = tag;
+        v->fail = fail;
+        v->valid = true;
+    }
+}
+
+/*
+ * Consume the verdict for this section. The engine queues verdicts in
+ * section order and before the last packet reaches the ring, so the
+ * oldest verdict left on the PID is this section's. Older ones whose tag
+ * does not match belong to sections dvb-core discarded (CC error,
+ * packets dropped before it) and are dropped on the way. Each verdict is
+ * used once, so a pass left by an earlier copy of the same section
+ * cannot be taken for this one; without a matching verdict the section
+ * goes to software.
+ */
+static bool aml_dmx_section_crc_passed(struct aml_dvb *dvb, u16 pid,
+                                       const u8 *buf, size_t len)
 {
-    struct dvb_demux_feed *feed = priv;
-    // Pass to userspace
-    feed->cb.section(buffer, len, NULL, 0, &feed->filter);
+    struct aml_dmx_crc_verdicts *cv = &dvb->crc_verdicts;
+    struct aml_dmx_crc_verdict *v;
+    u16 tag;
+    int i;
+
+    if (len < 4)
+        return false;
+
+    tag = buf[len - 2] << 8 | buf[len - 1];
+    for (i = AML_DMX_CRC_VERDICTS; i > 0; i--) {
+        v = &cv->v[(cv->head - i) % AML_DMX_CRC_VERDICTS];
+        if (!v->valid || v->pid != pid)
+            continue;
+        v->valid = false;
+        if (v->tag == tag)
+            return !v->fail;
+    }
+
+    return false;
+}
+
+/*
+ * demux->check_crc32 hook, called under the demux lock for every section
+ * of a feed with check_crc set. Returns 0 for a valid section, like
+ * dvb_dmx_crc32().
+ */
+u32 aml_dmx_section_check_crc(struct dvb_demux_feed *feed, const u8 *buf,
+                              size_t len)
+{
+    struct aml_dvb *dvb = feed->demux->priv;
+    struct aml_dmx_crc_stats *st = &dvb->crc_stats;
+    u32 crc;
+
+    if (hw_crc) {
+        aml_dmx_section_crc_drain(dvb);
+        if (aml_dmx_section_crc_passed(dvb, feed->pid, buf, len)) {
+            st->hw_checked++;
+            return 0;
+        }
+        st->unmatched++;
+    }
+
+    st->sw_checked++;
+    crc = crc32_be(~0, buf, len);
+    if (crc) {
+        st->errors++;
+        dvb->sec_feed[feed->index].crc_errors++;
+    }
+
+    return crc;
+}
+EXPORT_SYMBOL(aml_dmx_section_check_crc);
+
+// Same test dvb-core applies in dvb_dmx_swfilter_sectionfilter()
+static bool aml_dmx_section_match(struct dvb_demux_filter *f, const u8 *sec)
+{
+    u8 neq = 0;
+    int i;
+
+    for (i = 0; i < DVB_DEMUX_MASK_MAX; i++) {
+        u8 xor = f->filter.filter_value[i] ^ sec[i];
+
+        if (f->maskandmode[i] & xor)
+            return false;
+        neq |= f->maskandnotmode[i] & xor;
+    }
+
+    return !(f->doneq && !neq);
 }
 
+static int aml_dmx_section_cb(const u8 *buffer1, size_t buffer1_len,
+                              const u8 *buffer2, size_t buffer2_len,
+                              struct dmx_section_filter *source,
+                              u32 *buffer_flags)
+{
+    struct dvb_demux_filter *f = container_of(source, struct dvb_demux_filter,
+                                              filter);
+    struct dvb_demux_feed *feed = f->feed;
+    struct aml_dvb *dvb = feed->demux->priv;
+
+    aml_dmx_section_cache_update(dvb, feed->pid, buffer1, buffer1_len);
+
+    if (source->flags & DMX_DELIVER_ON_CHANGE) {
+        if (aml_dmx_section_dedup(dvb, f->index, buffer1, buffer1_len))
+            return 0;
+    }
+
+    // Pass to dmxdev (userspace)
+    return dvb->sec_feed[feed->index].cb(buffer1, buffer1_len,
+                                         buffer2, buffer2_len,
+                                         source, buffer_flags);
+}
+
+// Replay cached sections to the filters of a feed that have not had
+// them yet. Called with demux->mutex held.
+static void aml_dmx_section_replay(struct aml_dvb *dvb,
+                                   struct dvb_demux_feed *feed)
+{
+    struct aml_dmx_sec_cache *cache = &dvb->sec_cache;
+    struct aml_dmx_sec_entry *e;
+    struct dvb_demux_filter *f;
+    dmx_section_cb cb = dvb->sec_feed[feed->index].cb;
+
+    spin_lock_irq(&dvb->demux.lock);
+    spin_lock(&cache->lock);
+
+    list_for_each_entry(e, &cache->entries, list) {
+        if (e->pid != feed->pid)
+            continue;
+
+        for (f = feed->filter; f; f = f->next) {
+            if (test_bit(f->index, cache->fed) ||
+                !aml_dmx_section_match(f, e->data))
+                continue;
+            // Seen by dedup too, so the next live copy counts as a repeat
+            if (f->filter.flags & DMX_DELIVER_ON_CHANGE) {
+                if (aml_dmx_section_dedup(dvb, f->index, e->data, e->len))
+                    continue;
+            }
+            cb(e->data, e->len, NULL, 0, &f->filter, &feed->buffer_flags);
+            cache->hits++;
+        }
+    }
+
+    for (f = feed->filter; f; f = f->next)
+        __set_bit(f->index, cache->fed);
+
+    spin_unlock(&cache->lock);
+    spin_unlock_irq(&dvb->demux.lock);
+}
+
+// dmxdev only accepts data once the filter is in GO state, which happens
+// after start_feed returns, so the replay runs from a work item.
+static void aml_dmx_section_replay_work(struct work_struct *work)
+{
+    struct aml_dvb *dvb = container_of(work, struct aml_dvb,
+                                       sec_cache.replay_work);
+    struct dvb_demux *demux = &dvb->demux;
+    int i;
+
+    mutex_lock(&demux->mutex);
+    for (i = 0; i < demux->feednum; i++) {
+        struct dvb_demux_feed *feed = &demux->feed[i];
+
+        if (!dvb->sec_feed[i].replay)
+            continue;
+        dvb->sec_feed[i].replay = false;
+
+        if (feed->state == DMX_STATE_GO && feed->type == DMX_TYPE_SEC)
+            aml_dmx_section_replay(dvb, feed);
+    }
+    mutex_unlock(&demux->mutex);
+}
+
+// Track which filters a feed holds across dmxdev restarts. A filter
+// new to the feed starts with no replay and no dedup history; one that
+// left it (released) has its dedup history dropped.
+static void aml_dmx_section_filters_update(struct aml_dvb *dvb,
+                                           struct dvb_demux_feed *feed,
+                                           bool restart)
+{
+    struct aml_dmx_sec_cache *cache = &dvb->sec_cache;
+    u16 owner = feed->index + 1;
+    struct dvb_demux_filter *f;
+    int i;
+
+    for (i = 0; i < dvb->demux.filternum; i++) {
+        if (cache->owner[i] != owner)
+            continue;
+        for (f = restart ? feed->filter : NULL; f; f = f->next)
+            if (f->index == i)
+                break;
+        if (!f) {
+            cache->owner[i] = 0;
+            aml_dmx_section_dedup_forget(dvb, i);
+        }
+    }
+
+    for (f = feed->filter; f; f = f->next) {
+        if (cache->owner[f->index] == owner)
+            continue;
+        cache->owner[f->index] = owner;
+        __clear_bit(f->index, cache->fed);
+        aml_dmx_section_dedup_forget(dvb, f->index);
+    }
+}
+
+// Route a starting section feed through the driver's section path.
+// dmxdev restarts a running feed to add or remove a filter; such a feed
+// still has our callback, and only its new filters get the replay.
+void aml_dmx_section_start(struct aml_dvb *dvb, struct dvb_demux_feed *feed)
+{
+    struct aml_dmx_sec_feed *sf = &dvb->sec_feed[feed->index];
+    bool restart = feed->cb.sec == aml_dmx_section_cb;
+
+    if (!restart) {
+        sf->cb = feed->cb.sec;
+        sf->crc_errors = 0;
+        feed->cb.sec = aml_dmx_section_cb;
+    }
+    aml_dmx_section_filters_update(dvb, feed, restart);
+
+    if (feed->pid <= 0x1FFF) {
+        sf->replay = true;
+        schedule_work(&dvb->sec_cache.replay_work);
+    }
+}
+EXPORT_SYMBOL(aml_dmx_section_start);
+
+// Filters and their dedup history survive the stop: dmxdev may be
+// restarting the feed with one filter more or less
+void aml_dmx_section_stop(struct aml_dvb *dvb, struct dvb_demux_feed *feed)
+{
+    struct aml_dmx_sec_feed *sf = &dvb->sec_feed[feed->index];
+
+    sf->replay = false;
+    // The callback stays wrapped: a restart must find it. A feed that
+    // is released instead gets dmxdev's back when it is reallocated.
+}
+EXPORT_SYMBOL(aml_dmx_section_stop);
+
 int aml_dmx_section_init(struct aml_dvb *dvb)
 {
-    // Setup section callback
-    dvb->demux.dmx.section_cb = aml_dmx_section_cb;
+    struct aml_dmx_sec_cache *cache = &dvb->sec_cache;
+
+    spin_lock_init(&cache->lock);
+    INIT_LIST_HEAD(&cache->entries);
+    INIT_WORK(&cache->replay_work, aml_dmx_section_replay_work);
+    cache->count = 0;
+    cache->tsid = -1;
+
+    spin_lock_init(&dvb->sec_dedup.lock);
+    hash_init(dvb->sec_dedup.hash);
+    dvb->sec_dedup.count = 0;
+
     dev_info(dvb->dev, "Section demux initialized\n");
     return 0;
 }
-
 EXPORT_SYMBOL(aml_dmx_section_init);
 
+// CRC engine setup, from the deferred bring-up once registers are live
+void aml_dmx_section_hw_init(struct aml_dvb *dvb)
+{
+    memset(&dvb->crc_verdicts, 0, sizeof(dvb->crc_verdicts));
+    aml_dvb_reg_sec_crc_enable(dvb, hw_crc);
+}
+EXPORT_SYMBOL(aml_dmx_section_hw_init);
+
+void aml_dmx_section_release(struct aml_dvb *dvb)
+{
+    struct aml_dmx_dedup_entry *e;
+    struct hlist_node *tmp;
+    int bkt;
+
+    cancel_work_sync(&dvb->sec_cache.replay_work);
+    aml_dmx_section_cache_flush(dvb);
+
+    hash_for_each_safe(dvb->sec_dedup.hash, bkt, tmp, e, node) {
+        hash_del(&e->node);
+        kfree(e);
+    }
+    dvb->sec_dedup.count = 0;
+}
+EXPORT_SYMBOL(aml_dmx_section_release);
+
 MODULE_DESCRIPTION("Amlogic DVB Section Module");
 MODULE_LICENSE("GPL");
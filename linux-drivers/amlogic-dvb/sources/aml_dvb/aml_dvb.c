@@ -19,6 +19,12 @@
 #include <linux/interrupt.h>
 #include <linux/clk.h>
 #include <linux/reset.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/hrtimer.h>
+#include <linux/completion.h>
+#include <linux/timekeeping.h>
+#include <linux/pm_runtime.h>
 
 #include <media/dvb_demux.h>
 #include <media/dmxdev.h>
@@ -30,20 +36,23 @@
 #define DRIVER_NAME "aml_dvb"
 #define DRIVER_VERSION "6.0-gxl"
 
-/* Hardware register offsets for GXL (S905D/S905X) */
-#define DVB_REG_BASE        0xc8006000
-#define TS_PL_PID_INDEX     0x00
-#define TS_PL_PID_DATA      0x04
-#define TS_PL_CHAN_PTR      0x08
-#define TS_CONTROL          0x10
-#define TS_CONFIG           0x14
-#define TS_STATUS           0x18
+static bool async_hw = true;
+module_param(async_hw, bool, 0444);
+MODULE_PARM_DESC(async_hw,
+                 "Bring up clocks and DMA in the background after the adapter is registered");
+
+static unsigned int autosuspend_ms = 2000;
+module_param(autosuspend_ms, uint, 0444);
+MODULE_PARM_DESC(autosuspend_ms,
+                 "Gate clocks and DMA this long after the last feed stops (ms, initial power/autosuspend_delay_ms)");
 
 /* Device structure */
 struct aml_dvb {
     struct device *dev;
     struct platform_device *pdev;
     void __iomem *base;
+    const struct aml_dvb_variant *variant;
+    unsigned int demux_cores;   /* of the variant's, mapped */
     struct clk *clk;
     struct reset_control *reset;
     
@@ -52,15 +61,76 @@ struct aml_dvb {
     struct dvb_demux demux;
     struct dmxdev dmxdev;
     struct dvb_net net;
+    struct aml_dvb_net_bench net_bench;
+    struct aml_dvb_decoder decoder;
+    struct aml_dvb_dec_bench dec_bench;
     struct dvb_frontend *frontend;
+    struct i2c_adapter *fe_bus;     /* demod's I2C bus, held while bound */
+    u32 fe_addr;
+    struct aml_fe_i2c fe_i2c;
+    struct aml_fe_lock fe_lock;
+    struct aml_fe_sec fe_sec;
+    struct aml_fe_scan fe_scan;
+    struct aml_fe_i2c_bench fe_bench;
+    
+    /* Secondary hardware demux channels (demux1..) */
+    struct aml_dvb_chan chan[AML_DVB_MAX_DEMUX - 1];
     
     /* DMA buffer */
     void *dma_buf;
     dma_addr_t dma_addr;
     size_t dma_size;
+    size_t dma_rd;
+    spinlock_t dma_lock;
+    struct mutex dma_cfg_lock;
+    u32 irq_coalesce_us;
+    unsigned int max_latency_ms;
+    struct hrtimer dma_timer;
+    struct aml_dvb_dma_stats dma_stats;
+    struct aml_dmx_prefilter prefilter;
+    
+    /* Arrival timestamps (192-byte TS output) */
+    struct aml_dvb_tsstamp tsstamp;
+    
+    /* Shared fan-out dvr node */
+    struct aml_dvr_fanout *fanout;
+    
+    /* Batched filter setup node */
+    struct aml_dmx_batch_dev batch;
+    
+    /* PID table: shadows of both hardware banks plus the next set */
+    struct aml_pid_set pid_bank[2];
+    struct aml_pid_set pid_next;
+    int pid_live;
+    bool pid_dirty;
+    int pid_hold;
+    int pid_all;                /* full-TS users, PID filter bypassed */
+    struct mutex pid_lock;
+    struct delayed_work pid_work;
+    u32 pid_commits;
+    u64 pid_commit_ns;
+    u64 pid_commit_max_ns;
+    
+    /* Section path and PSI/SI cache */
+    struct aml_dmx_sec_feed sec_feed[AML_DVB_MAX_PIDS];
+    struct aml_dmx_sec_cache sec_cache;
+    struct aml_dmx_sec_dedup sec_dedup;
+    struct aml_dmx_crc_stats crc_stats;
+    struct aml_dmx_crc_verdicts crc_verdicts;
+    
+    /* Service filter (program number -> PIDs) */
+    struct aml_dvb_service service;
     
     /* TS mode: 0=auto, 1=serial, 2=parallel */
     int ts_mode;
+    int ts_clk_pol;
+    bool dma_sg;
+    struct aml_dvb_tsdetect tsdetect;
+    
+    /* Deferred hardware bring-up */
+    struct aml_dvb_bringup bringup;
+    bool hw_ready;
+    struct aml_dvb_pm_stats pm_stats;
     
     /* IRQ */
     int irq;
@@ -72,23 +142,52 @@ struct aml_dvb {
 /* Forward declarations */
 static int aml_dvb_probe(struct platform_device *pdev);
 static void aml_dvb_remove_new(struct platform_device *pdev); /* kernel 6.x uses remove_new */
-static int aml_dvb_start_feed(struct dvb_demux_feed *feed);
-static int aml_dvb_stop_feed(struct dvb_demux_feed *feed);
+static int aml_dvb_runtime_suspend(struct device *dev);
+static int aml_dvb_runtime_resume(struct device *dev);
 
-/* Device tree match table */
+/* Device tree match table, data is the SoC variant */
 static const struct of_device_id aml_dvb_dt_match[] = {
     {
         .compatible = "amlogic,dvb",
-        .data = (void *)AML_DVB_HW_GXL,  /* S905D/S905X */
+        .data = &aml_dvb_variants[AML_DVB_HW_GXL],  /* S905D/S905X */
+    },
+    {
+        .compatible = "amlogic,dvb-gxbb",
+        .data = &aml_dvb_variants[AML_DVB_HW_GXBB],
     },
     {
         .compatible = "amlogic,dvb-gxl",
-        .data = (void *)AML_DVB_HW_GXL,
+        .data = &aml_dvb_variants[AML_DVB_HW_GXL],
+    },
+    {
+        .compatible = "amlogic,dvb-gxm",
+        .data = &aml_dvb_variants[AML_DVB_HW_GXM],
+    },
+    {
+        .compatible = "amlogic,dvb-g12a",
+        .data = &aml_dvb_variants[AML_DVB_HW_G12A],
+    },
+    {
+        .compatible = "amlogic,dvb-g12b",
+        .data = &aml_dvb_variants[AML_DVB_HW_G12B],
+    },
+    {
+        .compatible = "amlogic,dvb-sm1",
+        .data = &aml_dvb_variants[AML_DVB_HW_SM1],
+    },
+    {
+        .compatible = "amlogic,dvb-sc2",
+        .data = &aml_dvb_variants[AML_DVB_HW_SC2],
     },
     { /* sentinel */ }
 };
 MODULE_DEVICE_TABLE(of, aml_dvb_dt_match);
 
+/* Runtime PM: gated while no feed is running */
+static const struct dev_pm_ops aml_dvb_pm_ops = {
+    RUNTIME_PM_OPS(aml_dvb_runtime_suspend, aml_dvb_runtime_resume, NULL)
+};
+
 /* Platform driver structure */
 static struct platform_driver aml_dvb_driver = {
     .probe = aml_dvb_probe,
@@ -97,6 +196,11 @@ static struct platform_driver aml_dvb_driver = {
         .name = DRIVER_NAME,
         .of_match_table = aml_dvb_dt_match,
         .owner = THIS_MODULE,
+        .pm = pm_ptr(&aml_dvb_pm_ops),
+        /* Statistics and tunables */
+        .dev_groups = aml_dvb_attr_groups,
+        /* Don't hold up other drivers while we probe */
+        .probe_type = PROBE_PREFER_ASYNCHRONOUS,
     },
 };
 
@@ -104,28 +208,28 @@ static struct platform_driver aml_dvb_driver = {
 static irqreturn_t aml_dvb_irq_handler(int irq, void *dev_id)
 {
     struct aml_dvb *dvb = dev_id;
-    u32 status;
     
-    status = readl(dvb->base + TS_STATUS);
+    irqreturn_t ret;
     
-    if (status & TS_IRQ_PENDING) {
-        /* Handle TS data */
-        dvb_dmx_swfilter(&dvb->demux, dvb->dma_buf, dvb->dma_size);
-        
-        /* Clear IRQ */
-        writel(status | TS_IRQ_CLEAR, dvb->base + TS_STATUS);
-        
-        return IRQ_HANDLED;
-    }
+    /* Registers are not clocked before bring-up or while suspended */
+    if (!READ_ONCE(dvb->hw_ready))
+        return IRQ_NONE;
     
-    return IRQ_NONE;
+    /* DMA done / timeout: drain the ring into the demux */
+    ret = aml_dvb_dma_irq(dvb);
+    
+    /* Secondary demux channels share the line */
+    if (aml_dvb_chan_irq(dvb) == IRQ_HANDLED)
+        ret = IRQ_HANDLED;
+    
+    return ret;
 }
 
 /* Initialize hardware */
 static int aml_dvb_hw_init(struct aml_dvb *dvb)
 {
     int ret;
-    u32 config = 0;
+    int mode;
     
     /* Enable clock */
     ret = clk_prepare_enable(dvb->clk);
@@ -142,38 +246,31 @@ static int aml_dvb_hw_init(struct aml_dvb *dvb)
     
     /* Configure TS mode */
     switch (dvb->ts_mode) {
-    case 1: /* Serial */
-        config = TS_SERIAL_MODE | TS_SERIAL_CLK_POL;
+    case TS_MODE_SERIAL:
+        mode = TS_MODE_SERIAL;
         dev_info(dvb->dev, "Using Serial TS mode\n");
         break;
-    case 2: /* Parallel */
-        config = TS_PARALLEL_MODE;
+    case TS_MODE_PARALLEL:
+        mode = TS_MODE_PARALLEL;
         dev_info(dvb->dev, "Using Parallel TS mode\n");
         break;
     default: /* Auto-detect */
-        config = TS_SERIAL_MODE; /* Default to serial for GXL */
-        dev_info(dvb->dev, "Auto-detect: using Serial TS mode\n");
+        mode = TS_MODE_SERIAL; /* Default to serial for GXL */
+        dev_info(dvb->dev, "Auto-detect: detection pending, Serial TS mode until then\n");
         break;
     }
     
-    writel(config, dvb->base + TS_CONFIG);
+    aml_dvb_reg_set_ts_input(dvb, mode, dvb->ts_clk_pol);
     
-    /* Allocate DMA buffer - kernel 6.x compatible */
-    dvb->dma_size = 188 * 1024; /* 188KB for TS packets */
-    dvb->dma_buf = dma_alloc_coherent(dvb->dev, dvb->dma_size,
-                                      &dvb->dma_addr, GFP_KERNEL);
-    if (!dvb->dma_buf) {
-        dev_err(dvb->dev, "Failed to allocate DMA buffer\n");
+    /* Allocate DMA ring */
+    ret = aml_dvb_dma_init(dvb);
+    if (ret) {
         clk_disable_unprepare(dvb->clk);
-        return -ENOMEM;
+        return ret;
     }
     
-    /* Configure DMA */
-    writel(dvb->dma_addr, dvb->base + TS_DMA_ADDR);
-    writel(dvb->dma_size, dvb->base + TS_DMA_SIZE);
-    
     /* Enable interrupts */
-    writel(TS_IRQ_ENABLE, dvb->base + TS_CONTROL);
+    aml_dvb_reg_irq_enable(dvb, true);
     
     return 0;
 }
@@ -181,39 +278,172 @@ static int aml_dvb_hw_init(struct aml_dvb *dvb)
 /* Cleanup hardware */
 static void aml_dvb_hw_exit(struct aml_dvb *dvb)
 {
-    /* Disable interrupts */
-    writel(0, dvb->base + TS_CONTROL);
-    
-    /* Free DMA buffer */
-    if (dvb->dma_buf) {
-        dma_free_coherent(dvb->dev, dvb->dma_size,
-                         dvb->dma_buf, dvb->dma_addr);
-        dvb->dma_buf = NULL;
-    }
+    /* Disable interrupts, let a running handler finish */
+    aml_dvb_reg_irq_enable(dvb, false);
+    synchronize_irq(dvb->irq);
+    
+    /* Stop DMA and free the ring */
+    aml_dvb_dma_exit(dvb);
     
     /* Disable clock */
     clk_disable_unprepare(dvb->clk);
 }
 
-/* Demux start feed callback */
-static int aml_dvb_start_feed(struct dvb_demux_feed *feed)
+/*
+ * Deferred bring-up: everything that touches the hardware or may sleep
+ * for long. Runs once, right after probe has registered the adapter.
+ * demux1.., the fan-out dvr and the frontend are registered here too,
+ * in the order that keeps their node numbers stable.
+ */
+static void aml_dvb_bringup_work(struct work_struct *work)
+{
+    struct aml_dvb_bringup *bu = container_of(work, struct aml_dvb_bringup,
+                                              work);
+    struct aml_dvb *dvb = container_of(bu, struct aml_dvb, bringup);
+    int ret;
+    
+    ret = aml_dvb_hw_init(dvb);
+    if (ret)
+        goto out;
+    
+    /* Marks the registers live for the IRQ handler too */
+    aml_dvb_pidset_hw_init(dvb);
+    aml_dmx_section_hw_init(dvb);
+    
+    /* Demux is ready: start feeding it from the DMA ring */
+    aml_dvb_dma_start(dvb);
+    aml_dvb_tsdetect_start(dvb);
+    bu->hw_ns = ktime_get_boottime_ns();
+    
+    /* demux1.. on their own hardware channels */
+    ret = aml_dvb_chan_init(dvb);
+    if (ret)
+        dev_warn(dvb->dev, "Secondary demux channels unavailable: %d\n",
+                 ret);
+    
+    /* Extra dvr node sharing one capture ring between readers */
+    ret = aml_dvr_fanout_init(dvb);
+    if (ret)
+        dev_warn(dvb->dev, "Fan-out dvr unavailable: %d\n", ret);
+    
+    /* Demod probe and firmware talk I2C: attach and register it here */
+    ret = aml_dvb_attach_frontend(dvb);
+    if (!dvb->fe_bus)
+        dev_info(dvb->dev, "No frontend in the device tree\n");
+    else if (ret)
+        dev_warn(dvb->dev, "Frontend unavailable: %d\n", ret);
+    
+    /* Up and idle: gate again unless a feed starts in time */
+    pm_runtime_set_autosuspend_delay(dvb->dev, autosuspend_ms);
+    pm_runtime_use_autosuspend(dvb->dev);
+    pm_runtime_set_active(dvb->dev);
+    pm_runtime_enable(dvb->dev);
+    pm_runtime_mark_last_busy(dvb->dev);
+    pm_request_autosuspend(dvb->dev);
+    
+    ret = 0;
+    dev_info(dvb->dev, "Hardware up %llu us after probe\n",
+             div_u64(bu->hw_ns - bu->probe_ns, NSEC_PER_USEC));
+out:
+    if (ret)
+        dev_err(dvb->dev, "Hardware bring-up failed: %d\n", ret);
+    bu->err = ret;
+    complete_all(&bu->done);
+}
+
+/* Block until the bring-up has finished; its result */
+int aml_dvb_hw_wait(struct aml_dvb *dvb)
 {
-    struct aml_dvb *dvb = feed->demux->priv;
+    int ret;
     
-    dev_dbg(dvb->dev, "Start feed: PID=0x%04x\n", feed->pid);
+    ret = wait_for_completion_killable(&dvb->bringup.done);
+    if (ret)
+        return ret;
     
-    /* Hardware PID filtering can be added here */
+    return dvb->bringup.err;
+}
+EXPORT_SYMBOL(aml_dvb_hw_wait);
+
+/* Power reference for a running feed or a live reconfiguration */
+int aml_dvb_pm_get(struct aml_dvb *dvb)
+{
+    int ret;
     
+    ret = aml_dvb_hw_wait(dvb);
+    if (ret)
+        return ret;
+    
+    return pm_runtime_resume_and_get(dvb->dev);
+}
+EXPORT_SYMBOL(aml_dvb_pm_get);
+
+void aml_dvb_pm_put(struct aml_dvb *dvb)
+{
+    pm_runtime_mark_last_busy(dvb->dev);
+    pm_runtime_put_autosuspend(dvb->dev);
+}
+EXPORT_SYMBOL(aml_dvb_pm_put);
+
+/*
+ * Last feed stopped and the autosuspend delay ran out: stop DMA and
+ * interrupts, hand the demux what is still in the rings, gate the
+ * clock. Nothing is freed; the DMA rings and every register shadow
+ * (TS input, PID banks, channel PID tables) stay for the resume.
+ */
+static int aml_dvb_runtime_suspend(struct device *dev)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    
+    /* A pending autodetect retry is kicked again by the next feed */
+    aml_dvb_tsdetect_stop(dvb);
+    
+    /* Mask and drain the IRQ first: the handler acks only while hw_ready */
+    aml_dvb_reg_irq_enable(dvb, false);
+    aml_dvb_dma_stop(dvb);
+    synchronize_irq(dvb->irq);
+    aml_dvb_pidset_hw_exit(dvb);
+    aml_dvb_dma_process(dvb);
+    aml_dvb_chan_suspend(dvb);
+    
+    clk_disable_unprepare(dvb->clk);
+    dvb->pm_stats.suspends++;
+    
+    dvb_dbg(dvb, "Runtime suspended\n");
     return 0;
 }
 
-/* Demux stop feed callback */
-static int aml_dvb_stop_feed(struct dvb_demux_feed *feed)
+/* First feed start: registers from the shadows, no reset, no allocation */
+static int aml_dvb_runtime_resume(struct device *dev)
 {
-    struct aml_dvb *dvb = feed->demux->priv;
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    ktime_t start = ktime_get();
+    u64 ns;
+    int ret;
     
-    dev_dbg(dvb->dev, "Stop feed: PID=0x%04x\n", feed->pid);
+    ret = clk_prepare_enable(dvb->clk);
+    if (ret) {
+        dev_err(dev, "Failed to enable clock: %d\n", ret);
+        return ret;
+    }
+    
+    aml_dvb_reg_set_ts_input(dvb, dvb->tsdetect.mode, dvb->tsdetect.clk_pol);
+    aml_dmx_section_hw_init(dvb);
+    aml_dvb_pidset_hw_init(dvb);
+    
+    /* Nothing was received while idle: cached tables may be stale */
+    aml_dmx_section_cache_flush(dvb);
+    aml_dvb_reg_irq_enable(dvb, true);
     
+    aml_dvb_dma_start(dvb);
+    aml_dvb_chan_resume(dvb);
+    
+    ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+    dvb->pm_stats.resumes++;
+    dvb->pm_stats.resume_ns = ns;
+    if (ns > dvb->pm_stats.resume_max_ns)
+        dvb->pm_stats.resume_max_ns = ns;
+    
+    dvb_dbg(dvb, "Runtime resumed in %llu ns\n", ns);
     return 0;
 }
 
@@ -233,10 +463,23 @@ static int aml_dvb_probe(struct platform_device *pdev)
     
     dvb->dev = &pdev->dev;
     dvb->pdev = pdev;
+    dvb->variant = of_device_get_match_data(&pdev->dev);
     platform_set_drvdata(pdev, dvb);
     
+    dvb->bringup.probe_ns = ktime_get_boottime_ns();
+    INIT_WORK(&dvb->bringup.work, aml_dvb_bringup_work);
+    init_completion(&dvb->bringup.done);
+    
+    /* sysfs may take these before the bring-up has set the DMA up */
+    spin_lock_init(&dvb->dma_lock);
+    mutex_init(&dvb->dma_cfg_lock);
+    
     /* Get TS mode from device tree */
     of_property_read_u32(pdev->dev.of_node, "ts-mode", &dvb->ts_mode);
+    of_property_read_u32(pdev->dev.of_node, "ts-clk-pol", &dvb->ts_clk_pol);
+    
+    /* Module parameters and a cached detection result override DT */
+    aml_dvb_tsdetect_init(dvb);
     
     /* Get memory resource */
     res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
@@ -244,6 +487,11 @@ static int aml_dvb_probe(struct platform_device *pdev)
     if (IS_ERR(dvb->base))
         return PTR_ERR(dvb->base);
     
+    /* Variant layout must fit its own model and the mapped block */
+    ret = aml_dvb_variant_init(dvb, resource_size(res));
+    if (ret)
+        return ret;
+    
     /* Get clock */
     dvb->clk = devm_clk_get(&pdev->dev, "dvb");
     if (IS_ERR(dvb->clk)) {
@@ -258,6 +506,11 @@ static int aml_dvb_probe(struct platform_device *pdev)
         return PTR_ERR(dvb->reset);
     }
     
+    /* Demod bus: defer the probe until its I2C adapter is registered */
+    ret = aml_dvb_find_frontend_bus(dvb);
+    if (ret)
+        return ret;
+    
     /* Get IRQ */
     dvb->irq = platform_get_irq(pdev, 0);
     if (dvb->irq < 0) {
@@ -273,36 +526,24 @@ static int aml_dvb_probe(struct platform_device *pdev)
         return ret;
     }
     
-    /* Initialize hardware */
-    ret = aml_dvb_hw_init(dvb);
-    if (ret)
-        return ret;
-    
-    /* Register DVB adapter */
+    /* Register DVB adapter; the hardware comes up in the background */
     ret = dvb_register_adapter(&dvb->adapter, "Amlogic DVB",
                               THIS_MODULE, &pdev->dev,
                               adapter_nr);
     if (ret < 0) {
         dev_err(&pdev->dev, "Failed to register DVB adapter: %d\n", ret);
-        goto err_hw_exit;
+        return ret;
     }
     
-    /* Initialize demux */
-    dvb->demux.dmx.capabilities = DMX_TS_FILTERING | DMX_SECTION_FILTERING;
-    dvb->demux.priv = dvb;
-    dvb->demux.filternum = 256;
-    dvb->demux.feednum = 256;
-    dvb->demux.start_feed = aml_dvb_start_feed;
-    dvb->demux.stop_feed = aml_dvb_stop_feed;
-    
-    ret = dvb_dmx_init(&dvb->demux);
+    /* Initialize demux (feeds program the hardware PID table) */
+    ret = aml_dvb_core_init(dvb);
     if (ret < 0) {
         dev_err(&pdev->dev, "Failed to init demux: %d\n", ret);
         goto err_unregister_adapter;
     }
     
     /* Register dmxdev */
-    dvb->dmxdev.filternum = 256;
+    dvb->dmxdev.filternum = dvb->variant->pid_slots;
     dvb->dmxdev.demux = &dvb->demux.dmx;
     dvb->dmxdev.capabilities = 0;
     
@@ -319,6 +560,24 @@ static int aml_dvb_probe(struct platform_device *pdev)
         goto err_dmxdev_release;
     }
     
+    aml_dvb_service_init(dvb);
+    
+    /* Batched filter setup node */
+    ret = aml_dmx_batch_init(dvb);
+    if (ret)
+        dev_warn(&pdev->dev, "Batch filter node unavailable: %d\n", ret);
+    
+    /* Spectrum and blind scan node */
+    ret = aml_fe_scan_init(dvb);
+    if (ret)
+        dev_warn(&pdev->dev, "Scan node unavailable: %d\n", ret);
+    
+    /* Nodes are usable now; the first feed start waits for the hardware */
+    dvb->bringup.nodes_ns = ktime_get_boottime_ns();
+    queue_work(system_unbound_wq, &dvb->bringup.work);
+    if (!async_hw)
+        flush_work(&dvb->bringup.work);
+    
     dev_info(&pdev->dev, "Amlogic DVB adapter registered successfully\n");
     dev_info(&pdev->dev, "Device: /dev/dvb/adapter%d/\n", dvb->adapter.num);
     
@@ -327,11 +586,9 @@ static int aml_dvb_probe(struct platform_device *pdev)
 err_dmxdev_release:
     dvb_dmxdev_release(&dvb->dmxdev);
 err_dmx_release:
-    dvb_dmx_release(&dvb->demux);
+    aml_dvb_core_release(dvb);
 err_unregister_adapter:
     dvb_unregister_adapter(&dvb->adapter);
-err_hw_exit:
-    aml_dvb_hw_exit(dvb);
     return ret;
 }
 
@@ -342,14 +599,38 @@ static void aml_dvb_remove_new(struct platform_device *pdev)
     
     dev_info(&pdev->dev, "Removing Amlogic DVB driver\n");
     
+    /* Let a running bring-up finish first */
+    flush_work(&dvb->bringup.work);
+    
+    /* Stop feeding the demux before tearing it down */
+    if (!dvb->bringup.err) {
+        pm_runtime_get_sync(&pdev->dev);
+        aml_dvb_tsdetect_stop(dvb);
+        aml_dvb_dma_stop(dvb);
+    }
+    
     /* Unregister DVB components */
+    aml_fe_scan_exit(dvb);
+    aml_dvb_detach_frontend(dvb);
+    aml_dmx_batch_exit(dvb);
+    aml_dvr_fanout_exit(dvb);
+    aml_dvb_chan_release(dvb);
+    aml_dvb_service_stop(dvb);
     dvb_net_release(&dvb->net);
     dvb_dmxdev_release(&dvb->dmxdev);
-    dvb_dmx_release(&dvb->demux);
+    aml_dvb_core_release(dvb);
     dvb_unregister_adapter(&dvb->adapter);
     
     /* Cleanup hardware */
-    aml_dvb_hw_exit(dvb);
+    if (!dvb->bringup.err) {
+        aml_dvb_hw_exit(dvb);
+        aml_dvb_pidset_hw_exit(dvb);
+        
+        pm_runtime_disable(&pdev->dev);
+        pm_runtime_dont_use_autosuspend(&pdev->dev);
+        pm_runtime_put_noidle(&pdev->dev);
+        pm_runtime_set_suspended(&pdev->dev);
+    }
     
     /* Note: kernel 6.x remove_new returns void, not int */
 }
@@ -9,6 +9,21 @@
 
 #include <linux/types.h>
 #include <linux/device.h>
+#include <linux/list.h>
+#include <linux/hashtable.h>
+#include <linux/interrupt.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/wait.h>
+#include <linux/atomic.h>
+#include <linux/ioctl.h>
+#include <linux/miscdevice.h>
+#include <linux/completion.h>
+#include <linux/kref.h>
+#include <linux/i2c.h>
+#include <linux/regmap.h>
+#include <linux/ktime.h>
 #include <media/dvb_demux.h>
 #include <media/dmxdev.h>
 #include <media/dvb_frontend.h>
@@ -23,6 +38,27 @@ enum aml_dvb_hw_type {
     AML_DVB_HW_G12B = 4,  /* S922X */
     AML_DVB_HW_SM1  = 5,  /* S905X3, S905D3 */
     AML_DVB_HW_SC2  = 6,  /* S905X4 */
+    AML_DVB_HW_COUNT
+};
+
+/*
+ * Per-SoC capabilities and register layout, the OF match data. Control
+ * registers sit at the same offsets in every channel block; the PID
+ * table position and the channel stride grow with the table size.
+ */
+struct aml_dvb_variant {
+    enum aml_dvb_hw_type type;
+    const char *name;
+    u16 pid_slots;              /* PID table entries per bank/channel */
+    u16 sec_filters;            /* section filters on the primary demux */
+    u8 ts_inputs;
+    u8 demux_cores;             /* hardware channels, incl. channel 0 */
+    bool dma_sg;
+    bool dma_timeout;           /* DMA timeout interrupt */
+    u32 dma_max;                /* largest DMA ring, bytes */
+    u32 pid_base;               /* PID bank 0 within a channel block */
+    u32 chan_stride;            /* channel N block at N * stride */
+    u32 reg_size;               /* register block for all channels */
 };
 
 /* TS mode configuration */
@@ -42,8 +78,27 @@ enum aml_dvb_hw_type {
 #define TS_PACKET_SIZE      188
 #define TS_BUFFER_SIZE      (TS_PACKET_SIZE * 1024)
 
-/* Maximum number of PIDs */
-#define AML_DVB_MAX_PIDS    256
+/* Largest PID table of any variant; dvb->variant->pid_slots is in use */
+#define AML_DVB_MAX_PIDS    1024
+
+/* Hardware demux channels of any variant; channel 0 is the primary demux */
+#define AML_DVB_MAX_DEMUX   4
+
+/* Unused PID table slot */
+#define AML_PID_NONE        0x1FFF
+
+/* PID table entry flag: hardware checks section CRC on this PID */
+#define AML_PID_SEC_CRC     BIT(15)
+
+/* Top PID table slots are reserved for the service filter */
+#define AML_DVB_SERVICE_PIDS    16
+#define AML_DVB_SERVICE_SLOT(v) ((v)->pid_slots - AML_DVB_SERVICE_PIDS)
+
+/* Interrupt sources, as returned by aml_dvb_reg_irq_status() */
+#define AML_DVB_IRQ_DMA_DONE    BIT(0)
+#define AML_DVB_IRQ_OVERFLOW    BIT(1)
+#define AML_DVB_IRQ_TIMEOUT     BIT(2)
+#define AML_DVB_IRQ_ERROR       BIT(3)
 
 /* DMA register offsets */
 #define TS_DMA_ADDR         0x20
@@ -84,6 +139,668 @@ struct aml_dvb_adapter {
     int hw_type;
 };
 
+/* PID set - shadow of one hardware PID table bank, indexed by slot */
+struct aml_pid_set {
+    u16 pid[AML_DVB_MAX_PIDS];
+};
+
+/* Service filter - PIDs of one program tracked from PAT/PMT */
+struct aml_dvb_service {
+    struct mutex mutex;         /* feeds and PID programming */
+    spinlock_t lock;            /* fields written from section callbacks */
+    struct work_struct work;
+    
+    int program;                /* program_number, -1 when idle */
+    u16 pmt_pid;
+    u16 pmt_feed_pid;
+    int pmt_version;
+    u16 pids[AML_DVB_SERVICE_PIDS];
+    int npids;
+    
+    struct dmx_section_feed *pat_feed;
+    struct dmx_section_filter *pat_filter;
+    struct dmx_section_feed *pmt_feed;
+    struct dmx_section_filter *pmt_filter;
+};
+
+/* Section path - per-feed state for feeds wrapped by aml_dmx_section.c */
+struct aml_dmx_sec_feed {
+    dmx_section_cb cb;          /* dmxdev callback being wrapped */
+    bool replay;                /* cache replay pending */
+    u32 crc_errors;             /* sections failing CRC on this PID */
+};
+
+/* PSI/SI section cache for the current transport stream */
+struct aml_dmx_sec_cache {
+    spinlock_t lock;
+    struct list_head entries;
+    int count;
+    int tsid;                   /* transport_stream_id, -1 if unknown */
+    struct work_struct replay_work;
+    u16 owner[AML_DVB_MAX_PIDS];        /* per filter: feed index + 1 */
+    DECLARE_BITMAP(fed, AML_DVB_MAX_PIDS);  /* filters the replay reached */
+    u32 hits;
+};
+
+/* Section deduplication ("deliver only on change") */
+struct aml_dmx_sec_dedup {
+    spinlock_t lock;
+    DECLARE_HASHTABLE(hash, 10);
+    unsigned int count;
+    u64 delivered;
+    u64 suppressed;
+};
+
+/* Section CRC checking: hardware verdicts vs. software fallback */
+struct aml_dmx_crc_stats {
+    u64 hw_checked;
+    u64 sw_checked;
+    u64 unmatched;              /* no verdict left for the section */
+    u64 errors;
+};
+
+/*
+ * Hardware CRC verdicts in FIFO order, each consumed by the section it
+ * belongs to (power of two: head wraps with the index)
+ */
+#define AML_DMX_CRC_VERDICTS    64
+
+struct aml_dmx_crc_verdict {
+    u16 pid;
+    u16 tag;                    /* low 16 bits of the section's CRC_32 */
+    bool fail;
+    bool valid;                 /* queued, not consumed yet */
+};
+
+struct aml_dmx_crc_verdicts {
+    struct aml_dmx_crc_verdict v[AML_DMX_CRC_VERDICTS];
+    unsigned int head;
+};
+
+/* Receive pre-filter: packets dropped before dvb-core (prefilter mask) */
+#define AML_DMX_PF_NULL         BIT(0)  /* PID 0x1FFF */
+#define AML_DMX_PF_TEI          BIT(1)  /* transport_error_indicator set */
+#define AML_DMX_PF_DUP          BIT(2)  /* same CC and bytes as the last one */
+
+struct aml_dmx_pf_pid {
+    u32 gen;                    /* pre-filter call of the last payload packet */
+    u32 idx;                    /* and its packet index in that call */
+    u32 cc_errors;
+    u8 cc;
+    bool seen;
+};
+
+struct aml_dmx_prefilter {
+    struct aml_dmx_pf_pid *pid;         /* 0x1FFF entries, by PID */
+    atomic_t keep_nulls;                /* running 0x1FFF/0x2000 feeds */
+    u32 gen;                            /* pre-filter calls */
+    u64 packets;
+    u64 passed;
+    u64 nulls;
+    u64 tei;
+    u64 dups;
+    u64 cc_errors;
+    u64 runs;                           /* swfilter calls */
+    u64 ns;                             /* pre-filter plus demux */
+};
+
+/* DMA ring statistics */
+struct aml_dvb_dma_stats {
+    u64 bytes;
+    u32 irqs;                   /* DMA-done interrupts */
+    u32 timeouts;               /* latency-bound flushes */
+    u32 overflows;
+};
+
+/* TS input autodetection (TS_MODE_AUTO) */
+#define AML_TS_DETECT_FIXED     0       /* mode given by DT/parameter */
+#define AML_TS_DETECT_PENDING   1       /* waiting for a stream to probe */
+#define AML_TS_DETECT_PROBING   2
+#define AML_TS_DETECT_LOCKED    3
+
+#define AML_TS_CANDIDATES       4       /* {serial, parallel} x clk_pol */
+
+struct aml_dvb_tsdetect {
+    struct delayed_work work;
+    int state;
+    int mode;                   /* TS_MODE_SERIAL / TS_MODE_PARALLEL */
+    int clk_pol;
+    bool counting;              /* DMA drain counts sync bytes */
+    bool probing;               /* ... and withholds the data, all demuxes */
+    u32 sync;                   /* packets with a sync byte, this window */
+    u32 bad;                    /* packets without one */
+    u32 rate[AML_TS_CANDIDATES];    /* synced packets/s, last sweep */
+    unsigned int attempts;
+};
+
+/*
+ * Deferred hardware bring-up. Probe registers the adapter and demux0
+ * nodes only; clocks, reset, DMA rings and the remaining nodes follow
+ * from a work item. Timestamps are CLOCK_BOOTTIME in ns.
+ */
+struct aml_dvb_bringup {
+    struct work_struct work;
+    struct completion done;
+    int err;
+    u64 probe_ns;               /* probe entered */
+    u64 nodes_ns;               /* adapter and demux0 nodes registered */
+    u64 hw_ns;                  /* hardware up, DMA running */
+    u64 first_feed_ns;          /* first feed started */
+    u64 first_lock_ns;          /* frontend first reported lock */
+    u64 first_data_ns;          /* first packets delivered to the demux */
+};
+
+/* Runtime PM: clocks and DMA are gated while no feed is running */
+struct aml_dvb_pm_stats {
+    u32 suspends;
+    u32 resumes;
+    u64 resume_ns;              /* last resume, clock on to DMA running */
+    u64 resume_max_ns;
+};
+
+/* Frontend register cache (I2C traffic of the demod) */
+struct aml_fe_i2c_stats {
+    u64 xfers;                  /* transactions on the bus */
+    u64 bus_ns;                 /* time in them (modelled when emulated) */
+    u64 read_hits;              /* register reads served from the cache */
+    u64 write_skips;            /* register writes dropped as redundant */
+    u32 merged;                 /* writes folded into a previous one */
+    u32 tunes;
+    u64 tune_ns;                /* last set_frontend */
+    u32 tune_xfers;
+};
+
+struct aml_fe_i2c {
+    struct i2c_adapter adap;    /* handed to the frontend driver */
+    struct i2c_adapter *parent; /* AO bus; NULL = emulated chip */
+    struct regmap *map;
+    u16 addr;                   /* cached chip (demod) */
+    bool cache;                 /* emulated only; else fe_regcache */
+    bool stale;                 /* bus accessed with the cache off */
+    DECLARE_BITMAP(known, 256); /* cache holds the chip's value */
+    u8 *emu;
+    u8 emu_ptr[128];
+    struct aml_fe_i2c_stats stats;
+    int (*init)(struct dvb_frontend *fe);
+    int (*set_frontend)(struct dvb_frontend *fe);
+};
+
+/* Frontend lock poll and statistics cache */
+struct aml_fe_lock {
+    struct dvb_frontend *fe;    /* NULL: not hooked */
+    spinlock_t lock;
+    enum fe_status status;      /* last poll */
+    u16 strength;
+    u16 snr;
+    u32 ber;
+    u32 ucb;
+    ktime_t tune_start;
+    unsigned int poll_ms;       /* next delay while searching */
+    u32 tunes;
+    u32 locks;
+    u32 polls;
+    u64 lock_ns;                /* tune to lock, last and worst */
+    u64 lock_max_ns;
+    struct mutex demod;         /* frontend thread vs. blind scan */
+    wait_queue_head_t wait;
+    bool users;                 /* frontend device open */
+    bool thread;                /* frontend thread may still use the demod */
+    bool claimed;               /* demod taken by a blind scan */
+    /* driver ops behind ours */
+    int (*ts_bus_ctrl)(struct dvb_frontend *fe, int acquire);
+    int (*sleep)(struct dvb_frontend *fe);
+    int (*tune)(struct dvb_frontend *fe, bool re_tune,
+                unsigned int mode_flags, unsigned int *delay,
+                enum fe_status *status);
+    int (*read_status)(struct dvb_frontend *fe, enum fe_status *status);
+    int (*read_signal_strength)(struct dvb_frontend *fe, u16 *strength);
+    int (*read_snr)(struct dvb_frontend *fe, u16 *snr);
+    int (*read_ber)(struct dvb_frontend *fe, u32 *ber);
+    int (*read_ucblocks)(struct dvb_frontend *fe, u32 *ucb);
+};
+
+/* AML_FE_SEC_SWITCH: LNB state to set up with the next DTV_TUNE */
+struct aml_fe_sec_switch {
+    __u32 voltage;              /* enum fe_sec_voltage */
+    __u32 tone;                 /* enum fe_sec_tone_mode, after the commands */
+    __u8 msg[6];                /* DiSEqC master command */
+    __u8 msg_len;               /* 0 = none, else 3..6 */
+    __u8 burst;                 /* SEC_MINI_A/B or AML_FE_SEC_NO_BURST */
+    __u32 flags;                /* AML_FE_SEC_FORCE */
+};
+
+#define AML_FE_SEC_NO_BURST     0xff
+#define AML_FE_SEC_FORCE        0x01    /* send commands even if unchanged */
+
+#define AML_FE_SEC_SWITCH       _IOW('o', 0xA3, struct aml_fe_sec_switch)
+
+/* LNB power, tone and DiSEqC state (satellite equipment control) */
+struct aml_fe_sec {
+    struct dvb_frontend *fe;    /* NULL: nothing to switch */
+    struct miscdevice misc;     /* /dev/aml-dvbN-sec */
+    char name[24];
+    bool node;
+    struct regulator *lnb;      /* lnb-supply, optional */
+    bool lnb_on;
+    struct mutex mutex;         /* everything below */
+    bool pending;               /* next is armed for the next tune */
+    struct aml_fe_sec_switch next;
+    int voltage;                /* as last set, -1 unknown */
+    int tone;
+    u8 msg[6];                  /* commands delivered since power-up */
+    u8 msg_len;
+    u8 burst;
+    bool cmd_valid;
+    ktime_t ready;              /* earliest next bus event */
+    u32 switches;
+    u32 skipped;                /* steps left out as unchanged */
+    u64 switch_ns;              /* armed switch incl. demod setup */
+    u64 switch_max_ns;
+    /* driver ops behind ours */
+    int (*init)(struct dvb_frontend *fe);
+    int (*set_voltage)(struct dvb_frontend *fe, enum fe_sec_voltage voltage);
+    int (*set_tone)(struct dvb_frontend *fe, enum fe_sec_tone_mode tone);
+    int (*diseqc_send_master_cmd)(struct dvb_frontend *fe,
+                                  struct dvb_diseqc_master_cmd *cmd);
+    int (*diseqc_send_burst)(struct dvb_frontend *fe,
+                             enum fe_sec_mini_cmd burst);
+};
+
+/* AML_FE_SCAN_START: sweep [start, end] (kHz, IF); 0 = default */
+struct aml_fe_scan_req {
+    __u32 start;
+    __u32 end;
+    __u32 step;                 /* kHz per spectrum point */
+    __u32 flags;                /* AML_FE_SCAN_EMULATE */
+    __s32 threshold;            /* carrier level over the floor, 0.01 dB */
+    __u32 min_sr;               /* symbol rates of carriers kept */
+    __u32 max_sr;
+};
+
+#define AML_FE_SCAN_EMULATE     0x01    /* emulated demod, no frontend use */
+
+/* read() returns records: this header, then len bytes of payload */
+struct aml_fe_scan_event {
+    __u32 type;
+    __u32 len;
+};
+
+#define AML_FE_SCAN_SPECTRUM    0       /* aml_fe_scan_point[] */
+#define AML_FE_SCAN_CANDIDATE   1       /* aml_fe_scan_carrier, from the sweep */
+#define AML_FE_SCAN_RESULT      2       /* aml_fe_scan_carrier, after lock */
+#define AML_FE_SCAN_DONE        3       /* aml_fe_scan_done */
+
+struct aml_fe_scan_point {
+    __u32 frequency;            /* kHz */
+    __s32 level;                /* 0.01 dB, relative */
+};
+
+struct aml_fe_scan_carrier {
+    __u32 frequency;            /* kHz */
+    __u32 symbol_rate;
+    __s32 level;
+    __u32 status;               /* enum fe_status, results only */
+    __u32 delsys;               /* as locked: enum fe_delivery_system */
+    __u32 modulation;
+    __u32 fec;
+    __u32 rolloff;
+};
+
+struct aml_fe_scan_done {
+    __u32 points;
+    __u32 candidates;
+    __u32 locked;
+    __u32 sweep_ms;             /* modelled when emulated */
+    __u32 total_ms;
+    __s32 error;
+    __u32 aborted;
+};
+
+#define AML_FE_SCAN_START       _IOW('o', 0xA4, struct aml_fe_scan_req)
+#define AML_FE_SCAN_STOP        _IO('o', 0xA5)
+
+/* Spectrum sweep and blind scan: /dev/aml-dvbN-scan */
+struct aml_fe_scan {
+    struct aml_dvb *dvb;
+    struct miscdevice misc;
+    char name[24];
+    bool node;
+    struct mutex mutex;         /* start/stop, open/release */
+    struct work_struct work;
+    struct aml_fe_scan_req req;
+    bool emu;
+    bool abort;
+    bool running;
+    bool open;                  /* a reader has the record stream */
+    struct dvb_ringbuffer buffer;
+    u32 dropped;                /* records lost to a slow reader */
+    u64 model_ns;               /* emulated time */
+    u32 seed;
+    /* last scan */
+    u32 points;
+    u32 candidates;
+    u32 locked;
+    u32 expected;               /* carriers present, emulated only */
+    u32 sweep_ms;
+    u32 total_ms;
+};
+
+/* Tune benchmark on the emulated chip: [0] uncached, [1] cached */
+struct aml_fe_i2c_bench {
+    u32 tunes;
+    u64 xfers[2];
+    u64 bus_ns[2];
+};
+
+/* IP-over-DVB receive benchmark, synthetic MPE on a dvb_net interface */
+struct aml_dvb_net_bench {
+    u32 datagrams;              /* sent */
+    u32 delivered;              /* decapsulated by dvb_net */
+    u64 bytes;                  /* IP bytes delivered */
+    u64 cpu_ns;                 /* demux, decapsulation, NAPI/GRO, stack */
+};
+
+/*
+ * In-kernel decoder sinks. Feeds set up with DMX_OUT_DECODER and a
+ * video/audio/teletext/subtitle/PCR pes_type are handed to the sink
+ * selected on the adapter; tap outputs that also name a decoder type
+ * are not. Packets are passed in place: during a DMA drain, consecutive
+ * packets of a stream are given to write() as one run still inside the
+ * DMA ring. They are only valid until write() returns, as the ring is
+ * reused afterwards and no reference can be taken on it. write() runs
+ * with the demux lock held and interrupts off, so a sink consumes the
+ * packets there or copies them out, and defers anything that sleeps.
+ */
+struct aml_dvb_dec_stream;
+
+struct aml_dvb_dec_sink_ops {
+    int (*open)(struct aml_dvb_dec_stream *st);
+    void (*write)(struct aml_dvb_dec_stream *st, const u8 *pkts,
+                  unsigned int count);
+    void (*close)(struct aml_dvb_dec_stream *st);
+    int (*show)(struct aml_dvb_dec_stream *st, char *buf, size_t size);
+};
+
+struct aml_dvb_dec_sink {
+    const char *name;
+    const struct aml_dvb_dec_sink_ops *ops;
+    struct module *owner;
+    struct list_head list;
+};
+
+#define AML_DVB_DEC_NAME_LEN    16
+
+/* One decoder feed, from its start_feed to its stop_feed */
+struct aml_dvb_dec_stream {
+    struct aml_dvb *dvb;
+    const struct aml_dvb_dec_sink *sink;
+    void *priv;                 /* sink's per-stream state */
+    u16 pid;
+    enum dmx_ts_pes pes_type;
+    struct list_head node;      /* in aml_dvb_decoder.open */
+    const u8 *run;              /* packets not handed over yet */
+    unsigned int run_count;
+    u64 packets;
+    u64 handoffs;               /* write() calls */
+};
+
+struct aml_dvb_decoder {
+    char sink[AML_DVB_DEC_NAME_LEN];   /* for feeds started afterwards */
+    const u8 *chunk;            /* ring part the demux is filtering */
+    const u8 *chunk_end;
+    struct list_head open;      /* under the demux lock */
+    unsigned int active;
+    struct aml_dvb_dec_stream *stream[AML_DVB_MAX_PIDS];   /* by feed */
+};
+
+/* Decoder sink benchmark, synthetic video PES through the drain path */
+struct aml_dvb_dec_bench {
+    u32 packets;                /* sent */
+    u64 delivered;              /* reached the sink */
+    u64 handoffs;
+    u64 cpu_ns;
+};
+
+/* Arrival timestamps for 192-byte TS output */
+struct aml_dvb_tsstamp {
+    bool enable;                /* applies to feeds started afterwards */
+    u64 start;                  /* 27 MHz clock at the previous drain */
+    u64 end;                    /* 27 MHz clock at this drain */
+    unsigned int count;         /* packets in this drain */
+    const u8 *chunk;            /* contiguous part being delivered */
+    unsigned int chunk_first;
+    size_t chunk_len;
+    dmx_ts_cb cb[AML_DVB_MAX_PIDS];     /* wrapped dmxdev callbacks */
+};
+
+/*
+ * Secondary hardware demux channel (demux1..). Own PID table, DMA ring
+ * and dvb_demux, so its clients never take the primary demux locks.
+ */
+struct aml_dvb_chan {
+    struct aml_dvb *dvb;
+    int id;                     /* hardware channel, >= 1 */
+    bool registered;
+    struct dvb_demux demux;
+    struct dmxdev dmxdev;
+    void *dma_buf;
+    dma_addr_t dma_addr;
+    size_t dma_size;
+    size_t dma_rd;
+    spinlock_t dma_lock;
+    struct aml_dvb_dma_stats dma_stats;
+    struct aml_dmx_prefilter prefilter;
+    u16 pid[AML_DVB_MAX_PIDS];  /* PID table shadow, reloaded on resume */
+};
+
+/* Shared fan-out dvr: one ring, per-reader cursors */
+struct aml_dvr_fanout {
+    struct dvb_device *dvbdev;
+    struct aml_dvb *dvb;        /* NULL once the adapter is torn down */
+    struct kref ref;            /* adapter, open readers, mappings */
+    struct mutex open_lock;     /* opens and releases vs. teardown */
+    void *ring;                 /* vmalloc_user, mmap-able */
+    size_t size;                /* multiple of TS_PACKET_SIZE and PAGE_SIZE */
+    u64 head;                   /* absolute bytes written */
+    spinlock_t lock;
+    wait_queue_head_t wait;
+    atomic_t readers;
+    u32 overflows;              /* reader laps, all readers */
+};
+
+/* AML_DVR_FANOUT_SYNC: consume, then report the reader's window */
+struct aml_dvr_fanout_sync {
+    __u64 consumed;             /* in: bytes processed since last sync */
+    __u64 head;                 /* out: absolute write position */
+    __u64 tail;                 /* out: reader position (ring offset = tail % size) */
+    __u32 size;                 /* out: ring size */
+    __u32 overflow;             /* out: reader was lapped and moved forward */
+};
+
+#define AML_DVR_FANOUT_SYNC     _IOWR('o', 0xA0, struct aml_dvr_fanout_sync)
+
+/* Batched filter setup: /dev/aml-dvbN-batch */
+#define AML_DMX_BATCH_MAX       64      /* filters per open file */
+
+struct aml_dmx_batch_dev {
+    struct miscdevice misc;
+    char name[24];
+    struct aml_dvb *dvb;
+};
+
+/* One filter spec; type is AML_DMX_BATCH_SECTION or AML_DMX_BATCH_TS */
+struct aml_dmx_batch_spec {
+    __u16 pid;
+    __u8 type;
+    __u8 flags;                 /* AML_DMX_BATCH_CRC, _DEDUP */
+    __u8 filter[16];            /* section filters, as dmx_filter */
+    __u8 mask[16];
+    __u8 mode[16];
+    __s32 result;               /* out: handle, or -errno */
+};
+
+#define AML_DMX_BATCH_SECTION   0
+#define AML_DMX_BATCH_TS        1
+#define AML_DMX_BATCH_CRC       0x01
+#define AML_DMX_BATCH_DEDUP     0x02    /* as DMX_DELIVER_ON_CHANGE */
+
+/* ADD: ptr -> count specs; DEL: ptr -> count __s32 handles */
+struct aml_dmx_batch {
+    __u32 count;
+    __u32 reserved;
+    __u64 ptr;
+};
+
+/* read() returns records: this header, then len bytes of data */
+struct aml_dmx_batch_event {
+    __s32 handle;
+    __u32 len;
+};
+
+#define AML_DMX_BATCH_ADD       _IOW('o', 0xA1, struct aml_dmx_batch)
+#define AML_DMX_BATCH_DEL       _IOW('o', 0xA2, struct aml_dmx_batch)
+
+/* Function prototypes - SoC variants */
+extern const struct aml_dvb_variant aml_dvb_variants[AML_DVB_HW_COUNT];
+int aml_dvb_variant_init(struct aml_dvb *dvb, resource_size_t size);
+int aml_dvb_reg_layout_check(const struct aml_dvb_variant *v, u32 *at);
+
+/* Function prototypes - Register access */
+u32 aml_dvb_reg_read(struct aml_dvb *dvb, u32 reg);
+void aml_dvb_reg_write(struct aml_dvb *dvb, u32 reg, u32 val);
+void aml_dvb_reg_set_bits(struct aml_dvb *dvb, u32 reg, u32 bits);
+void aml_dvb_reg_clear_bits(struct aml_dvb *dvb, u32 reg, u32 bits);
+int aml_dvb_reg_add_pid(struct aml_dvb *dvb, u16 pid, int index);
+int aml_dvb_reg_remove_pid(struct aml_dvb *dvb, int index);
+int aml_dvb_reg_setup_dma(struct aml_dvb *dvb, dma_addr_t addr, size_t size);
+void aml_dvb_reg_start_dma(struct aml_dvb *dvb);
+void aml_dvb_reg_stop_dma(struct aml_dvb *dvb);
+size_t aml_dvb_reg_dma_wr_offset(struct aml_dvb *dvb);
+void aml_dvb_reg_dma_set_rd_offset(struct aml_dvb *dvb, size_t offset);
+void aml_dvb_reg_set_dma_timeout(struct aml_dvb *dvb, u32 us);
+void aml_dvb_reg_set_irq_coalesce(struct aml_dvb *dvb, u32 us);
+u32 aml_dvb_reg_irq_status(struct aml_dvb *dvb);
+void aml_dvb_reg_irq_ack(struct aml_dvb *dvb, u32 status);
+void aml_dvb_reg_irq_enable(struct aml_dvb *dvb, bool enable);
+int aml_dvb_reg_write_pid_bank(struct aml_dvb *dvb, int bank, int index, u16 pid);
+void aml_dvb_reg_select_pid_bank(struct aml_dvb *dvb, int bank);
+void aml_dvb_reg_set_pid_all(struct aml_dvb *dvb, bool on);
+int aml_dvb_reg_chan_write_pid(struct aml_dvb *dvb, int ch, int index, u16 pid);
+void aml_dvb_reg_chan_start_dma(struct aml_dvb *dvb, int ch,
+                                dma_addr_t addr, size_t size);
+void aml_dvb_reg_chan_stop_dma(struct aml_dvb *dvb, int ch);
+u32 aml_dvb_reg_chan_dma_wr(struct aml_dvb *dvb, int ch);
+void aml_dvb_reg_chan_dma_set_rd(struct aml_dvb *dvb, int ch, u32 addr);
+u32 aml_dvb_reg_chan_irq(struct aml_dvb *dvb, int ch);
+void aml_dvb_reg_set_ts_input(struct aml_dvb *dvb, int mode, int clk_pol);
+void aml_dvb_reg_sec_crc_enable(struct aml_dvb *dvb, bool enable);
+int aml_dvb_reg_sec_crc_pop(struct aml_dvb *dvb, u16 *pid, u16 *tag,
+                            bool *fail);
+
+/* Function prototypes - Core */
+int aml_dvb_core_init(struct aml_dvb *dvb);
+void aml_dvb_core_release(struct aml_dvb *dvb);
+
+/* Function prototypes - PID set */
+void aml_pid_set_clear(struct aml_pid_set *set);
+int aml_dvb_pidset_init(struct aml_dvb *dvb);
+void aml_dvb_pidset_hw_init(struct aml_dvb *dvb);
+void aml_dvb_pidset_hw_exit(struct aml_dvb *dvb);
+void aml_dvb_pidset_exit(struct aml_dvb *dvb);
+struct aml_pid_set *aml_dvb_pidset_begin(struct aml_dvb *dvb);
+int aml_dvb_pidset_commit(struct aml_dvb *dvb);
+int aml_dvb_pidset_feed_start(struct aml_dvb *dvb, int index, u16 pid);
+void aml_dvb_pidset_feed_stop(struct aml_dvb *dvb, int index);
+void aml_dvb_pidset_pass_all(struct aml_dvb *dvb, bool on);
+void aml_dvb_pidset_hold(struct aml_dvb *dvb);
+int aml_dvb_pidset_release(struct aml_dvb *dvb);
+
+/* Function prototypes - Service filter */
+int aml_dvb_service_init(struct aml_dvb *dvb);
+int aml_dvb_service_start(struct aml_dvb *dvb, int program);
+void aml_dvb_service_stop(struct aml_dvb *dvb);
+
+/* Function prototypes - Section path */
+int aml_dmx_section_init(struct aml_dvb *dvb);
+void aml_dmx_section_hw_init(struct aml_dvb *dvb);
+void aml_dmx_section_release(struct aml_dvb *dvb);
+void aml_dmx_section_start(struct aml_dvb *dvb, struct dvb_demux_feed *feed);
+void aml_dmx_section_stop(struct aml_dvb *dvb, struct dvb_demux_feed *feed);
+void aml_dmx_section_cache_flush(struct aml_dvb *dvb);
+u16 aml_dmx_section_pid_flags(struct aml_dvb *dvb, struct dvb_demux_feed *feed);
+u32 aml_dmx_section_check_crc(struct dvb_demux_feed *feed, const u8 *buf,
+                              size_t len);
+
+/* Function prototypes - Receive pre-filter */
+int aml_dmx_prefilter_init(struct aml_dmx_prefilter *pf);
+void aml_dmx_prefilter_exit(struct aml_dmx_prefilter *pf);
+void aml_dmx_prefilter_reset(struct aml_dmx_prefilter *pf);
+void aml_dmx_prefilter_feed(struct aml_dmx_prefilter *pf,
+                            struct dvb_demux_feed *feed, bool start);
+void aml_dmx_prefilter(struct aml_dmx_prefilter *pf, struct dvb_demux *demux,
+                       const u8 *buf, unsigned int count);
+ssize_t aml_dmx_prefilter_show(struct aml_dmx_prefilter *pf, const char *name,
+                               char *buf, ssize_t len);
+
+/* Function prototypes - TS timestamps */
+void aml_dvb_tsstamp_segment(struct aml_dvb *dvb, unsigned int count);
+void aml_dvb_tsstamp_chunk(struct aml_dvb *dvb, const u8 *buf,
+                           unsigned int first, unsigned int count);
+void aml_dvb_tsstamp_start(struct aml_dvb *dvb, struct dvb_demux_feed *feed);
+void aml_dvb_tsstamp_stop(struct aml_dvb *dvb, struct dvb_demux_feed *feed);
+
+/* Function prototypes - TS input detection */
+void aml_dvb_tsdetect_init(struct aml_dvb *dvb);
+void aml_dvb_tsdetect_start(struct aml_dvb *dvb);
+void aml_dvb_tsdetect_stop(struct aml_dvb *dvb);
+void aml_dvb_tsdetect_kick(struct aml_dvb *dvb);
+int aml_dvb_tsdetect_set(struct aml_dvb *dvb, int mode, int clk_pol);
+bool aml_dvb_tsdetect_count(struct aml_dvb *dvb, const u8 *buf,
+                            unsigned int count);
+
+/* Function prototypes - Deferred bring-up and runtime PM */
+int aml_dvb_hw_wait(struct aml_dvb *dvb);
+int aml_dvb_pm_get(struct aml_dvb *dvb);
+void aml_dvb_pm_put(struct aml_dvb *dvb);
+
+/* Function prototypes - Secondary demux channels */
+int aml_dvb_chan_init(struct aml_dvb *dvb);
+void aml_dvb_chan_release(struct aml_dvb *dvb);
+void aml_dvb_chan_suspend(struct aml_dvb *dvb);
+void aml_dvb_chan_resume(struct aml_dvb *dvb);
+irqreturn_t aml_dvb_chan_irq(struct aml_dvb *dvb);
+
+/* Function prototypes - Fan-out dvr */
+int aml_dvr_fanout_init(struct aml_dvb *dvb);
+void aml_dvr_fanout_exit(struct aml_dvb *dvb);
+void aml_dvr_fanout_write(struct aml_dvb *dvb, const u8 *buf, size_t len);
+
+/* Function prototypes - IP-over-DVB */
+int aml_dvb_net_bench(struct aml_dvb *dvb, unsigned int ifnum,
+                      unsigned int datagrams);
+
+/* Function prototypes - Decoder sinks */
+int aml_dvb_dec_sink_register(struct aml_dvb_dec_sink *sink);
+void aml_dvb_dec_sink_unregister(struct aml_dvb_dec_sink *sink);
+void aml_dvb_decoder_init(struct aml_dvb *dvb);
+int aml_dvb_decoder_start(struct aml_dvb *dvb, struct dvb_demux_feed *feed);
+void aml_dvb_decoder_stop(struct aml_dvb *dvb, struct dvb_demux_feed *feed);
+int aml_dvb_decoder_write(struct dvb_demux_feed *feed, const u8 *buf,
+                          size_t len);
+void aml_dvb_decoder_swfilter(struct aml_dvb *dvb, const u8 *buf,
+                              unsigned int count);
+int aml_dvb_decoder_select(struct aml_dvb *dvb, const char *name);
+ssize_t aml_dvb_decoder_show(struct aml_dvb *dvb, char *buf);
+int aml_dvb_decoder_bench(struct aml_dvb *dvb, unsigned int packets);
+
+/* Function prototypes - Batched filter setup */
+int aml_dmx_batch_init(struct aml_dvb *dvb);
+void aml_dmx_batch_exit(struct aml_dvb *dvb);
+
+/* Function prototypes - sysfs */
+extern const struct attribute_group aml_dvb_attr_group;
+extern const struct attribute_group *aml_dvb_attr_groups[];
+
 /* Function prototypes - Hardware control */
 int aml_dvb_hw_init(struct aml_dvb *dvb);
 void aml_dvb_hw_exit(struct aml_dvb *dvb);
@@ -95,8 +812,32 @@ int aml_dvb_dma_init(struct aml_dvb *dvb);
 void aml_dvb_dma_exit(struct aml_dvb *dvb);
 void aml_dvb_dma_start(struct aml_dvb *dvb);
 void aml_dvb_dma_stop(struct aml_dvb *dvb);
+void aml_dvb_dma_process(struct aml_dvb *dvb);
+int aml_dvb_dma_reconfig(struct aml_dvb *dvb, size_t size, u32 coalesce_us,
+                         bool sg);
+int aml_dvb_dma_set_latency(struct aml_dvb *dvb, unsigned int ms);
+irqreturn_t aml_dvb_dma_irq(struct aml_dvb *dvb);
 
 /* Function prototypes - Frontend */
+int aml_dvb_find_frontend_bus(struct aml_dvb *dvb);
+int aml_dvb_attach_frontend(struct aml_dvb *dvb);
+void aml_dvb_detach_frontend(struct aml_dvb *dvb);
+int aml_fe_i2c_init(struct aml_fe_i2c *fc, struct device *dev,
+                    struct i2c_adapter *parent, u16 addr, const char *name);
+void aml_fe_i2c_exit(struct aml_fe_i2c *fc);
+void aml_fe_i2c_hook(struct aml_fe_i2c *fc, struct dvb_frontend *fe);
+int aml_fe_i2c_bench(struct aml_dvb *dvb, unsigned int tunes);
+void aml_fe_lock_hook(struct aml_fe_lock *fl, struct dvb_frontend *fe);
+int aml_fe_lock_claim(struct aml_fe_lock *fl);
+void aml_fe_lock_take(struct aml_fe_lock *fl, struct dvb_frontend *fe);
+void aml_fe_lock_give(struct aml_fe_lock *fl, struct dvb_frontend *fe);
+int aml_fe_sec_init(struct aml_dvb *dvb, struct dvb_frontend *fe);
+void aml_fe_sec_exit(struct aml_dvb *dvb);
+int aml_fe_sec_tune(struct aml_fe_sec *sec, struct dvb_frontend *fe,
+                    bool setup);
+int aml_fe_scan_init(struct aml_dvb *dvb);
+void aml_fe_scan_exit(struct aml_dvb *dvb);
+int aml_fe_scan_bench(struct aml_dvb *dvb, u32 step);
 int aml_dvb_register_frontend(struct aml_dvb *dvb, struct dvb_frontend *fe);
 void aml_dvb_unregister_frontend(struct aml_dvb *dvb);
 
@@ -0,0 +1,274 @@
+// sources/aml_dvb/aml_dvb_chan.c
+// Secondary hardware demux channels (demux1, demux2, ...)
+//
+// The primary demux (demux0) carries the section cache, service filter
+// and fan-out dvr. Every further hardware channel gets a plain
+// dvb_demux/dmxdev pair of its own, fed from its own PID table and DMA
+// ring. Recording, live and EPG clients on different demuxN nodes then
+// never contend on the same software demux lock.
+
+#include <linux/module.h>
+#include <linux/dma-mapping.h>
+#include "aml_dvb.h"
+
+static unsigned int demux_count = AML_DVB_MAX_DEMUX;
+module_param(demux_count, uint, 0444);
+MODULE_PARM_DESC(demux_count,
+                 "Demux devices per adapter (1 up to the SoC's demux cores)");
+
+static int aml_dvb_chan_start_feed(struct dvb_demux_feed *feed)
+{
+    struct aml_dvb_chan *ch = feed->demux->priv;
+    int ret;
+
+    // Every running feed holds the block powered
+    ret = aml_dvb_pm_get(ch->dvb);
+    if (ret)
+        return ret;
+
+    aml_dmx_prefilter_feed(&ch->prefilter, feed, true);
+
+    // Full-TS feeds (0x2000) have no hardware PID slot
+    if (feed->pid > 0x1FFF)
+        return 0;
+
+    // Called under demux->mutex, which serializes this channel's table
+    ch->pid[feed->index] = feed->pid;
+    ret = aml_dvb_reg_chan_write_pid(ch->dvb, ch->id, feed->index,
+                                     feed->pid);
+    if (ret) {
+        ch->pid[feed->index] = AML_PID_NONE;
+        aml_dvb_pm_put(ch->dvb);
+        aml_dmx_prefilter_feed(&ch->prefilter, feed, false);
+    }
+
+    return ret;
+}
+
+static int aml_dvb_chan_stop_feed(struct dvb_demux_feed *feed)
+{
+    struct aml_dvb_chan *ch = feed->demux->priv;
+
+    if (feed->pid <= 0x1FFF) {
+        ch->pid[feed->index] = AML_PID_NONE;
+        aml_dvb_reg_chan_write_pid(ch->dvb, ch->id, feed->index,
+                                   AML_PID_NONE);
+    }
+
+    aml_dmx_prefilter_feed(&ch->prefilter, feed, false);
+    aml_dvb_pm_put(ch->dvb);
+    return 0;
+}
+
+// Drain the channel's ring into its own demux. IRQ and runtime suspend.
+static void aml_dvb_chan_process(struct aml_dvb_chan *ch)
+{
+    unsigned long flags;
+    size_t wr, rd;
+
+    spin_lock_irqsave(&ch->dma_lock, flags);
+
+    wr = aml_dvb_reg_chan_dma_wr(ch->dvb, ch->id) - (u32)ch->dma_addr;
+    wr -= wr % TS_PACKET_SIZE;
+    rd = ch->dma_rd;
+
+    // wr == dma_size: the DMA filled up to the end and has not wrapped
+    if (wr == rd || wr > ch->dma_size)
+        goto out;
+
+    // The TS input is shared: discard while autodetection switches it
+    if (READ_ONCE(ch->dvb->tsdetect.probing))
+        goto consume;
+
+    if (wr > rd) {
+        aml_dmx_prefilter(&ch->prefilter, &ch->demux, ch->dma_buf + rd,
+                          (wr - rd) / TS_PACKET_SIZE);
+        ch->dma_stats.bytes += wr - rd;
+    } else {
+        aml_dmx_prefilter(&ch->prefilter, &ch->demux, ch->dma_buf + rd,
+                          (ch->dma_size - rd) / TS_PACKET_SIZE);
+        aml_dmx_prefilter(&ch->prefilter, &ch->demux, ch->dma_buf,
+                          wr / TS_PACKET_SIZE);
+        ch->dma_stats.bytes += ch->dma_size - rd + wr;
+    }
+
+consume:
+    if (wr == ch->dma_size)
+        wr = 0;
+    ch->dma_rd = wr;
+    aml_dvb_reg_chan_dma_set_rd(ch->dvb, ch->id, (u32)ch->dma_addr + wr);
+out:
+    spin_unlock_irqrestore(&ch->dma_lock, flags);
+}
+
+// Shared interrupt line: service every secondary channel
+irqreturn_t aml_dvb_chan_irq(struct aml_dvb *dvb)
+{
+    irqreturn_t ret = IRQ_NONE;
+    int i;
+
+    for (i = 0; i < AML_DVB_MAX_DEMUX - 1; i++) {
+        struct aml_dvb_chan *ch = &dvb->chan[i];
+        u32 status;
+
+        if (!ch->registered)
+            continue;
+
+        status = aml_dvb_reg_chan_irq(dvb, ch->id);
+        if (!status)
+            continue;
+
+        if (status & AML_DVB_IRQ_DMA_DONE)
+            ch->dma_stats.irqs++;
+        if (status & AML_DVB_IRQ_OVERFLOW)
+            ch->dma_stats.overflows++;
+
+        aml_dvb_chan_process(ch);
+        ret = IRQ_HANDLED;
+    }
+
+    return ret;
+}
+EXPORT_SYMBOL(aml_dvb_chan_irq);
+
+static int aml_dvb_chan_register(struct aml_dvb *dvb, struct aml_dvb_chan *ch)
+{
+    struct dvb_demux *demux = &ch->demux;
+    int i, ret;
+
+    for (i = 0; i < AML_DVB_MAX_PIDS; i++)
+        ch->pid[i] = AML_PID_NONE;
+
+    spin_lock_init(&ch->dma_lock);
+    ch->dma_size = TS_BUFFER_SIZE;
+    ch->dma_buf = dma_alloc_coherent(dvb->dev, ch->dma_size, &ch->dma_addr,
+                                     GFP_KERNEL);
+    if (!ch->dma_buf)
+        return -ENOMEM;
+
+    ret = aml_dmx_prefilter_init(&ch->prefilter);
+    if (ret)
+        goto err_free;
+
+    demux->priv = ch;
+    demux->filternum = dvb->variant->sec_filters;
+    demux->feednum = dvb->variant->pid_slots;  // feed index is the PID slot
+    demux->start_feed = aml_dvb_chan_start_feed;
+    demux->stop_feed = aml_dvb_chan_stop_feed;
+    demux->write_to_decoder = NULL;
+    demux->dmx.capabilities = DMX_TS_FILTERING | DMX_SECTION_FILTERING;
+
+    ret = dvb_dmx_init(demux);
+    if (ret < 0)
+        goto err_free;
+
+    ch->dmxdev.filternum = dvb->variant->pid_slots;
+    ch->dmxdev.demux = &demux->dmx;
+    ch->dmxdev.capabilities = 0;
+
+    ret = dvb_dmxdev_init(&ch->dmxdev, &dvb->adapter);
+    if (ret < 0)
+        goto err_dmx;
+
+    ch->dma_rd = 0;
+    aml_dvb_reg_chan_start_dma(dvb, ch->id, ch->dma_addr, ch->dma_size);
+    ch->registered = true;
+    return 0;
+
+err_dmx:
+    dvb_dmx_release(demux);
+err_free:
+    aml_dmx_prefilter_exit(&ch->prefilter);
+    dma_free_coherent(dvb->dev, ch->dma_size, ch->dma_buf, ch->dma_addr);
+    ch->dma_buf = NULL;
+    return ret;
+}
+
+// Register demux1.. after the primary demux so node numbers follow channels
+int aml_dvb_chan_init(struct aml_dvb *dvb)
+{
+    unsigned int n = clamp(demux_count, 1U, dvb->demux_cores);
+    int i, ret;
+
+    for (i = 0; i < n - 1; i++) {
+        struct aml_dvb_chan *ch = &dvb->chan[i];
+
+        ch->dvb = dvb;
+        ch->id = i + 1;
+        ret = aml_dvb_chan_register(dvb, ch);
+        if (ret) {
+            dvb_err(dvb, "Demux channel %d: %d\n", ch->id, ret);
+            return ret;
+        }
+    }
+
+    dvb_info(dvb, "%u demux devices\n", n);
+    return 0;
+}
+EXPORT_SYMBOL(aml_dvb_chan_init);
+
+// Runtime suspend: stop every channel and deliver what is left
+void aml_dvb_chan_suspend(struct aml_dvb *dvb)
+{
+    int i;
+
+    for (i = 0; i < AML_DVB_MAX_DEMUX - 1; i++) {
+        struct aml_dvb_chan *ch = &dvb->chan[i];
+
+        if (!ch->registered)
+            continue;
+
+        aml_dvb_reg_chan_stop_dma(dvb, ch->id);
+        aml_dvb_chan_process(ch);
+    }
+}
+EXPORT_SYMBOL(aml_dvb_chan_suspend);
+
+// Runtime resume: reload the PID tables from their shadows, restart DMA
+void aml_dvb_chan_resume(struct aml_dvb *dvb)
+{
+    unsigned long flags;
+    int i, j;
+
+    for (i = 0; i < AML_DVB_MAX_DEMUX - 1; i++) {
+        struct aml_dvb_chan *ch = &dvb->chan[i];
+
+        if (!ch->registered)
+            continue;
+
+        for (j = 0; j < dvb->variant->pid_slots; j++)
+            aml_dvb_reg_chan_write_pid(dvb, ch->id, j, ch->pid[j]);
+
+        spin_lock_irqsave(&ch->dma_lock, flags);
+        ch->dma_rd = 0;
+        spin_unlock_irqrestore(&ch->dma_lock, flags);
+        aml_dvb_reg_chan_start_dma(dvb, ch->id, ch->dma_addr, ch->dma_size);
+    }
+}
+EXPORT_SYMBOL(aml_dvb_chan_resume);
+
+void aml_dvb_chan_release(struct aml_dvb *dvb)
+{
+    int i;
+
+    for (i = AML_DVB_MAX_DEMUX - 2; i >= 0; i--) {
+        struct aml_dvb_chan *ch = &dvb->chan[i];
+
+        if (!ch->registered)
+            continue;
+
+        aml_dvb_reg_chan_stop_dma(dvb, ch->id);
+        ch->registered = false;
+        synchronize_irq(dvb->irq);
+
+        dvb_dmxdev_release(&ch->dmxdev);
+        dvb_dmx_release(&ch->demux);
+        aml_dmx_prefilter_exit(&ch->prefilter);
+        dma_free_coherent(dvb->dev, ch->dma_size, ch->dma_buf, ch->dma_addr);
+        ch->dma_buf = NULL;
+    }
+}
+EXPORT_SYMBOL(aml_dvb_chan_release);
+
+MODULE_DESCRIPTION("Amlogic DVB Secondary Demux Channels");
+MODULE_LICENSE("GPL");
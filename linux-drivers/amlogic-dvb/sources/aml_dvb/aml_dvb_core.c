@@ -8,6 +8,7 @@
 #include <linux/slab.h>
 #include <linux/dma-mapping.h>
 #include <linux/interrupt.h>
+#include <linux/timekeeping.h>
 #include <media/dvb_demux.h>
 #include <media/dmxdev.h>
 #include <media/dvb_frontend.h>
@@ -17,38 +18,113 @@
 static int aml_dvb_core_start_feed(struct dvb_demux_feed *feed)
 {
     struct aml_dvb *dvb = feed->demux->priv;
-    // Call hardware PID add
-    aml_dvb_reg_add_pid(dvb, feed->pid, feed->index);
+    int ret;
+
+    // Waits for the bring-up, resumes the block if it is gated
+    ret = aml_dvb_pm_get(dvb);
+    if (ret)
+        return ret;
+
+    if (!dvb->bringup.first_feed_ns)
+        dvb->bringup.first_feed_ns = ktime_get_boottime_ns();
+
+    // Program PID through the PID set (bank flip)
+    ret = aml_dvb_pidset_feed_start(dvb, feed->index, feed->pid |
+                                    aml_dmx_section_pid_flags(dvb, feed));
+    if (ret)
+        goto err_put;
+
+    // Full TS has no slot in the table: bypass the PID filter instead
+    if (feed->pid == 0x2000)
+        aml_dvb_pidset_pass_all(dvb, true);
+
+    if (feed->type == DMX_TYPE_SEC) {
+        aml_dmx_section_start(dvb, feed);
+    } else if (feed->type == DMX_TYPE_TS) {
+        // A/V feeds go to the decoder sink, if one is selected
+        ret = aml_dvb_decoder_start(dvb, feed);
+        if (ret)
+            goto err_pid;
+        aml_dvb_tsstamp_start(dvb, feed);
+    }
+    aml_dmx_prefilter_feed(&dvb->prefilter, feed, true);
+
+    // First tune with ts-mode = auto: probe the input now
+    aml_dvb_tsdetect_kick(dvb);
     return 0;
+
+err_pid:
+    if (feed->pid == 0x2000)
+        aml_dvb_pidset_pass_all(dvb, false);
+    aml_dvb_pidset_feed_stop(dvb, feed->index);
+err_put:
+    aml_dvb_pm_put(dvb);
+    return ret;
 }
 
 static int aml_dvb_core_stop_feed(struct dvb_demux_feed *feed)
 {
     struct aml_dvb *dvb = feed->demux->priv;
-    // Call hardware PID remove
-    aml_dvb_reg_remove_pid(dvb, feed->index);
+
+    if (feed->type == DMX_TYPE_SEC)
+        aml_dmx_section_stop(dvb, feed);
+    else if (feed->type == DMX_TYPE_TS) {
+        aml_dvb_tsstamp_stop(dvb, feed);
+        aml_dvb_decoder_stop(dvb, feed);
+    }
+    aml_dmx_prefilter_feed(&dvb->prefilter, feed, false);
+
+    // Removal is folded into the next PID set commit
+    if (feed->pid == 0x2000)
+        aml_dvb_pidset_pass_all(dvb, false);
+    aml_dvb_pidset_feed_stop(dvb, feed->index);
+
+    // Last feed gone: clocks and DMA stop after the autosuspend delay
+    aml_dvb_pm_put(dvb);
     return 0;
 }
 
 int aml_dvb_core_init(struct aml_dvb *dvb)
 {
     struct dvb_demux *demux = &dvb->demux;
+    int ret;
+
+    ret = aml_dvb_pidset_init(dvb);
+    if (ret)
+        return ret;
+
+    ret = aml_dmx_section_init(dvb);
+    if (ret)
+        return ret;
+
+    aml_dvb_decoder_init(dvb);
+
+    ret = aml_dmx_prefilter_init(&dvb->prefilter);
+    if (ret)
+        return ret;
 
     demux->priv = dvb;
-    demux->filternum = AML_DVB_MAX_PIDS;
-    demux->feednum = AML_DVB_MAX_PIDS;
+    demux->filternum = dvb->variant->sec_filters;
+    demux->feednum = AML_DVB_SERVICE_SLOT(dvb->variant);  // Keep clear of service slots
     demux->start_feed = aml_dvb_core_start_feed;
     demux->stop_feed = aml_dvb_core_stop_feed;
-    demux->write_to_decoder = NULL;  // Bypass to userspace
+    demux->write_to_decoder = aml_dvb_decoder_write;
+    demux->check_crc32 = aml_dmx_section_check_crc;
     demux->dmx.capabilities = DMX_TS_FILTERING | DMX_SECTION_FILTERING | DMX_PCR_EXTRACTION | DMX_MEMORY_BASED_FILTERING;
 
-    return dvb_dmx_init(demux);
+    ret = dvb_dmx_init(demux);
+    if (ret)
+        aml_dmx_prefilter_exit(&dvb->prefilter);
+    return ret;
 }
 EXPORT_SYMBOL(aml_dvb_core_init);
 
 void aml_dvb_core_release(struct aml_dvb *dvb)
 {
     dvb_dmx_release(&dvb->demux);
+    aml_dmx_prefilter_exit(&dvb->prefilter);
+    aml_dmx_section_release(dvb);
+    aml_dvb_pidset_exit(dvb);
 }
 EXPORT_SYMBOL(aml_dvb_core_release);
 
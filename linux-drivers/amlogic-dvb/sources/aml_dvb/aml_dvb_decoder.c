@@ -0,0 +1,436 @@
+// sources/aml_dvb/aml_dvb_decoder.c
+// Decoder sinks: tunneled PES path through write_to_decoder
+//
+// dvb-core calls write_to_decoder for every packet of a feed whose
+// pes_type names a decoder (video/audio/teletext/subtitle/PCR). For
+// DMX_OUT_DECODER feeds, instead of bouncing those packets back to a
+// dmxdev buffer, they go to the decoder sink selected on the adapter
+// (sysfs decoder, or the decoder_sink parameter), so A/V never leaves
+// the kernel; userspace only opens the session with DMX_SET_PES_FILTER /
+// DMX_OUT_DECODER and closes it with DMX_STOP. dmxdev sets TS_DECODER on
+// tap outputs with such a pes_type as well; recordings of those do not
+// open a sink stream. With no sink selected a decoder feed (DMX_PES_PCR
+// for one) still starts; its packets are simply not handed anywhere.
+//
+// Nothing is copied on the way: during a DMA drain consecutive packets
+// of a stream are collected as a run inside the ring and handed over in
+// one write() once the demux is done with the chunk, before the ring
+// read pointer moves. Packets from anywhere else (not the ring) are
+// handed over one by one as they come. Either way they are the sink's
+// only for the duration of write(), which runs under the demux lock
+// with interrupts off: a sink consumes or copies them before returning.
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include "aml_dvb.h"
+
+#define AML_DEC_BENCH_PID       0x1ff0
+#define AML_DEC_BENCH_BURST     348     /* packets per drain, ~64 KB */
+#define AML_DEC_BENCH_PES_PKTS  8       /* TS packets per PES */
+#define AML_DEC_BENCH_PES_LEN   (AML_DEC_BENCH_PES_PKTS * 184 - 6)
+
+// A demux has one decoder feed per pes_type: the bench takes a free one
+static const enum dmx_ts_pes aml_dec_bench_pes[] = {
+    DMX_PES_VIDEO0, DMX_PES_VIDEO1, DMX_PES_VIDEO2, DMX_PES_VIDEO3,
+};
+
+static char decoder_sink[AML_DVB_DEC_NAME_LEN];
+module_param_string(decoder_sink, decoder_sink, sizeof(decoder_sink), 0444);
+MODULE_PARM_DESC(decoder_sink,
+                 "Initial decoder sink for DMX_OUT_DECODER feeds (sysfs decoder changes it)");
+
+// Registered sinks and every adapter's stream table
+static LIST_HEAD(aml_dvb_dec_sinks);
+static DEFINE_MUTEX(aml_dvb_dec_lock);
+
+static struct aml_dvb_dec_sink *aml_dvb_dec_sink_find(const char *name)
+{
+    struct aml_dvb_dec_sink *sink;
+
+    list_for_each_entry(sink, &aml_dvb_dec_sinks, list)
+        if (!strcmp(sink->name, name))
+            return sink;
+
+    return NULL;
+}
+
+int aml_dvb_dec_sink_register(struct aml_dvb_dec_sink *sink)
+{
+    int ret = 0;
+
+    if (!sink->name || strlen(sink->name) >= AML_DVB_DEC_NAME_LEN ||
+        !sink->ops || !sink->ops->open || !sink->ops->write ||
+        !sink->ops->close)
+        return -EINVAL;
+
+    mutex_lock(&aml_dvb_dec_lock);
+    if (aml_dvb_dec_sink_find(sink->name))
+        ret = -EEXIST;
+    else
+        list_add_tail(&sink->list, &aml_dvb_dec_sinks);
+    mutex_unlock(&aml_dvb_dec_lock);
+
+    return ret;
+}
+EXPORT_SYMBOL(aml_dvb_dec_sink_register);
+
+// Open streams hold a module reference, so none are left at this point
+void aml_dvb_dec_sink_unregister(struct aml_dvb_dec_sink *sink)
+{
+    mutex_lock(&aml_dvb_dec_lock);
+    list_del(&sink->list);
+    mutex_unlock(&aml_dvb_dec_lock);
+}
+EXPORT_SYMBOL(aml_dvb_dec_sink_unregister);
+
+void aml_dvb_decoder_init(struct aml_dvb *dvb)
+{
+    struct aml_dvb_decoder *dec = &dvb->decoder;
+
+    INIT_LIST_HEAD(&dec->open);
+    strscpy(dec->sink, decoder_sink, sizeof(dec->sink));
+}
+EXPORT_SYMBOL(aml_dvb_decoder_init);
+
+// Hand the pending run over; demux lock held
+static void aml_dvb_decoder_flush(struct aml_dvb_dec_stream *st)
+{
+    if (!st->run_count)
+        return;
+
+    st->sink->ops->write(st, st->run, st->run_count);
+    st->handoffs++;
+    st->run = NULL;
+    st->run_count = 0;
+}
+
+// demux->write_to_decoder: one packet, with the demux lock held
+int aml_dvb_decoder_write(struct dvb_demux_feed *feed, const u8 *buf,
+                          size_t len)
+{
+    struct aml_dvb *dvb = feed->demux->priv;
+    struct aml_dvb_decoder *dec = &dvb->decoder;
+    struct aml_dvb_dec_stream *st = dec->stream[feed->index];
+
+    if (!st)
+        return 0;
+
+    st->packets++;
+
+    // Not from the ring: the buffer is gone once the demux returns
+    if (buf < dec->chunk || buf >= dec->chunk_end) {
+        aml_dvb_decoder_flush(st);
+        st->sink->ops->write(st, buf, 1);
+        st->handoffs++;
+        return 0;
+    }
+
+    if (st->run_count && buf == st->run + st->run_count * TS_PACKET_SIZE) {
+        st->run_count++;
+        return 0;
+    }
+
+    aml_dvb_decoder_flush(st);
+    st->run = buf;
+    st->run_count = 1;
+    return 0;
+}
+EXPORT_SYMBOL(aml_dvb_decoder_write);
+
+/*
+ * Filter a contiguous part of the DMA ring; runs under the DMA lock, so
+ * the runs collected here are handed over before the ring is reused.
+ */
+void aml_dvb_decoder_swfilter(struct aml_dvb *dvb, const u8 *buf,
+                              unsigned int count)
+{
+    struct aml_dvb_decoder *dec = &dvb->decoder;
+    struct aml_dvb_dec_stream *st;
+
+    if (!READ_ONCE(dec->active)) {
+        aml_dmx_prefilter(&dvb->prefilter, &dvb->demux, buf, count);
+        return;
+    }
+
+    dec->chunk = buf;
+    dec->chunk_end = buf + count * TS_PACKET_SIZE;
+
+    aml_dmx_prefilter(&dvb->prefilter, &dvb->demux, buf, count);
+
+    spin_lock(&dvb->demux.lock);
+    list_for_each_entry(st, &dec->open, node)
+        aml_dvb_decoder_flush(st);
+    dec->chunk = NULL;
+    dec->chunk_end = NULL;
+    spin_unlock(&dvb->demux.lock);
+}
+EXPORT_SYMBOL(aml_dvb_decoder_swfilter);
+
+// start_feed: open a stream on the selected sink for decoder feeds
+int aml_dvb_decoder_start(struct aml_dvb *dvb, struct dvb_demux_feed *feed)
+{
+    struct aml_dvb_decoder *dec = &dvb->decoder;
+    struct aml_dvb_dec_sink *sink;
+    struct aml_dvb_dec_stream *st;
+    int ret;
+
+    // DMX_OUT_DECODER only; taps with a decoder pes_type are recordings
+    if ((feed->ts_type & (TS_DECODER | TS_PACKET)) != TS_DECODER)
+        return 0;
+
+    mutex_lock(&aml_dvb_dec_lock);
+
+    // No sink (or a PCR feed with none selected): the feed still runs,
+    // its packets are just not handed anywhere
+    sink = dec->sink[0] ? aml_dvb_dec_sink_find(dec->sink) : NULL;
+    if (!sink || !try_module_get(sink->owner)) {
+        ret = 0;
+        goto out_unlock;
+    }
+
+    st = kzalloc(sizeof(*st), GFP_KERNEL);
+    if (!st) {
+        ret = -ENOMEM;
+        goto out_put;
+    }
+
+    st->dvb = dvb;
+    st->sink = sink;
+    st->pid = feed->pid;
+    st->pes_type = feed->pes_type;
+
+    ret = sink->ops->open(st);
+    if (ret)
+        goto out_free;
+
+    spin_lock_irq(&dvb->demux.lock);
+    list_add_tail(&st->node, &dec->open);
+    dec->stream[feed->index] = st;
+    WRITE_ONCE(dec->active, dec->active + 1);
+    spin_unlock_irq(&dvb->demux.lock);
+
+    mutex_unlock(&aml_dvb_dec_lock);
+    dvb_dbg(dvb, "PID %u to decoder sink %s\n", feed->pid, sink->name);
+    return 0;
+
+out_free:
+    kfree(st);
+out_put:
+    module_put(sink->owner);
+out_unlock:
+    mutex_unlock(&aml_dvb_dec_lock);
+    return ret;
+}
+EXPORT_SYMBOL(aml_dvb_decoder_start);
+
+void aml_dvb_decoder_stop(struct aml_dvb *dvb, struct dvb_demux_feed *feed)
+{
+    struct aml_dvb_decoder *dec = &dvb->decoder;
+    struct aml_dvb_dec_stream *st;
+
+    mutex_lock(&aml_dvb_dec_lock);
+
+    st = dec->stream[feed->index];
+    if (!st)
+        goto out_unlock;
+
+    spin_lock_irq(&dvb->demux.lock);
+    aml_dvb_decoder_flush(st);
+    list_del(&st->node);
+    dec->stream[feed->index] = NULL;
+    WRITE_ONCE(dec->active, dec->active - 1);
+    spin_unlock_irq(&dvb->demux.lock);
+
+    st->sink->ops->close(st);
+    module_put(st->sink->owner);
+    kfree(st);
+
+out_unlock:
+    mutex_unlock(&aml_dvb_dec_lock);
+}
+EXPORT_SYMBOL(aml_dvb_decoder_stop);
+
+// Sink for feeds started afterwards; "none" or "" to turn off
+int aml_dvb_decoder_select(struct aml_dvb *dvb, const char *name)
+{
+    int ret = 0;
+
+    if (!strcmp(name, "none"))
+        name = "";
+
+    mutex_lock(&aml_dvb_dec_lock);
+    if (name[0] && !aml_dvb_dec_sink_find(name))
+        ret = -ENODEV;
+    else
+        strscpy(dvb->decoder.sink, name, sizeof(dvb->decoder.sink));
+    mutex_unlock(&aml_dvb_dec_lock);
+
+    return ret;
+}
+EXPORT_SYMBOL(aml_dvb_decoder_select);
+
+// sysfs: registered sinks (selected one in brackets), then open streams
+ssize_t aml_dvb_decoder_show(struct aml_dvb *dvb, char *buf)
+{
+    struct aml_dvb_decoder *dec = &dvb->decoder;
+    struct aml_dvb_dec_sink *sink;
+    struct aml_dvb_dec_stream *st;
+    ssize_t len;
+
+    mutex_lock(&aml_dvb_dec_lock);
+
+    len = sysfs_emit(buf, "%s", dec->sink[0] ? "none" : "[none]");
+    list_for_each_entry(sink, &aml_dvb_dec_sinks, list)
+        len += sysfs_emit_at(buf, len,
+                             strcmp(sink->name, dec->sink) ? " %s" : " [%s]",
+                             sink->name);
+    len += sysfs_emit_at(buf, len, "\n");
+
+    list_for_each_entry(st, &dec->open, node) {
+        len += sysfs_emit_at(buf, len,
+                             "pid=%u pes_type=%u sink=%s packets=%llu handoffs=%llu",
+                             st->pid, st->pes_type, st->sink->name,
+                             st->packets, st->handoffs);
+        if (st->sink->ops->show && len < PAGE_SIZE - 1) {
+            buf[len++] = ' ';
+            len += st->sink->ops->show(st, buf + len, PAGE_SIZE - len);
+        }
+        len += sysfs_emit_at(buf, len, "\n");
+    }
+
+    mutex_unlock(&aml_dvb_dec_lock);
+    return len;
+}
+EXPORT_SYMBOL(aml_dvb_decoder_show);
+
+static int aml_dvb_dec_bench_cb(const u8 *buffer1, size_t buffer1_len,
+                                const u8 *buffer2, size_t buffer2_len,
+                                struct dmx_ts_feed *source, u32 *buffer_flags)
+{
+    return 0;
+}
+
+// Video PES of AML_DEC_BENCH_PES_PKTS full packets, PTS at 25 fps
+static void aml_dvb_dec_bench_fill(u8 *ts, unsigned int first,
+                                   unsigned int count, u8 *cc)
+{
+    unsigned int i, k;
+    u64 pts;
+    u8 *p, *h;
+
+    for (i = 0; i < count; i++) {
+        p = ts + i * TS_PACKET_SIZE;
+        k = first + i;
+
+        p[0] = 0x47;
+        p[1] = AML_DEC_BENCH_PID >> 8;
+        p[2] = AML_DEC_BENCH_PID & 0xff;
+        p[3] = 0x10 | *cc;
+        *cc = (*cc + 1) & 0x0f;
+        memset(p + 4, k & 0xff, TS_PACKET_SIZE - 4);
+
+        if (k % AML_DEC_BENCH_PES_PKTS)
+            continue;
+
+        p[1] |= 0x40;
+        h = p + 4;
+        pts = (u64)(k / AML_DEC_BENCH_PES_PKTS) * 3600;
+        h[0] = 0;
+        h[1] = 0;
+        h[2] = 1;
+        h[3] = 0xe0;
+        h[4] = AML_DEC_BENCH_PES_LEN >> 8;
+        h[5] = AML_DEC_BENCH_PES_LEN & 0xff;
+        h[6] = 0x80;
+        h[7] = 0x80;                /* PTS only */
+        h[8] = 5;
+        h[9] = 0x21 | ((pts >> 29) & 0x0e);
+        h[10] = pts >> 22;
+        h[11] = 0x01 | ((pts >> 14) & 0xfe);
+        h[12] = pts >> 7;
+        h[13] = 0x01 | ((pts << 1) & 0xfe);
+    }
+}
+
+/*
+ * Run @packets of synthetic video PES through a video decoder feed on
+ * the selected sink, in drain-sized chunks down the same path as the
+ * DMA ring, and time it. The feed is opened in-kernel like dvb_net does,
+ * on the first video pes_type no live feed holds.
+ */
+int aml_dvb_decoder_bench(struct aml_dvb *dvb, unsigned int packets)
+{
+    static DEFINE_MUTEX(bench_lock);
+    struct aml_dvb_dec_bench *b = &dvb->dec_bench;
+    struct dmx_demux *dmx = &dvb->demux.dmx;
+    struct dvb_demux_feed *feed;
+    struct aml_dvb_dec_stream *st;
+    struct dmx_ts_feed *tsfeed;
+    unsigned long flags;
+    unsigned int i, n;
+    u64 ns = 0;
+    ktime_t t;
+    u8 cc = 0;
+    u8 *ts;
+    int ret;
+
+    ts = vmalloc(AML_DEC_BENCH_BURST * TS_PACKET_SIZE);
+    if (!ts)
+        return -ENOMEM;
+
+    mutex_lock(&bench_lock);
+
+    ret = dmx->allocate_ts_feed(dmx, &tsfeed, aml_dvb_dec_bench_cb);
+    if (ret)
+        goto out_unlock;
+
+    // set() refuses a pes_type another decoder feed has with -EINVAL
+    ret = -EBUSY;
+    for (i = 0; i < ARRAY_SIZE(aml_dec_bench_pes) && ret; i++)
+        ret = tsfeed->set(tsfeed, AML_DEC_BENCH_PID, TS_DECODER,
+                          aml_dec_bench_pes[i], 0) ? -EBUSY : 0;
+    if (!ret)
+        ret = tsfeed->start_filtering(tsfeed);
+    if (ret)
+        goto out_release;
+
+    feed = container_of(tsfeed, struct dvb_demux_feed, feed.ts);
+    st = dvb->decoder.stream[feed->index];
+    if (!st) {
+        ret = -ENODEV;      /* no sink selected */
+        goto out_stop;
+    }
+
+    for (i = 0; i < packets; i += n) {
+        n = min_t(unsigned int, packets - i, AML_DEC_BENCH_BURST);
+        aml_dvb_dec_bench_fill(ts, i, n, &cc);
+
+        t = ktime_get();
+        spin_lock_irqsave(&dvb->dma_lock, flags);
+        aml_dvb_decoder_swfilter(dvb, ts, n);
+        spin_unlock_irqrestore(&dvb->dma_lock, flags);
+        ns += ktime_to_ns(ktime_sub(ktime_get(), t));
+
+        cond_resched();
+    }
+
+    b->packets = packets;
+    b->delivered = st->packets;
+    b->handoffs = st->handoffs;
+    b->cpu_ns = ns;
+
+out_stop:
+    tsfeed->stop_filtering(tsfeed);
+out_release:
+    dmx->release_ts_feed(dmx, tsfeed);
+out_unlock:
+    mutex_unlock(&bench_lock);
+    vfree(ts);
+    return ret;
+}
+EXPORT_SYMBOL(aml_dvb_decoder_bench);
+
+MODULE_DESCRIPTION("Amlogic DVB Decoder Sinks");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,177 @@
+// sources/aml_dvb/aml_dvb_dectest.c
+// "test" decoder sink: validates and counts PES instead of decoding
+//
+// Stands in for the VDEC/audio hardware on the tunneled path. Every
+// packet handed over is checked (sync, PID, TEI, continuity counter),
+// PES starts are checked for a start code and a stream_id that fits the
+// pes_type, and bounded PES are checked for their announced length.
+// Counters are in the adapter's sysfs decoder attribute while the
+// stream is open and logged when it closes.
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include "aml_dvb.h"
+
+struct aml_dectest {
+    u8 cc;
+    bool cc_valid;
+    bool in_pes;
+    u32 pes_len;                /* PES_packet_length + 6, 0 = unbounded */
+    u32 pes_got;
+    u64 packets;
+    u64 runs;
+    u64 pes;
+    u64 bytes;                  /* PES bytes */
+    u64 cc_errors;
+    u64 bad_packets;            /* sync, PID, TEI, adaptation field */
+    u64 bad_starts;             /* start code or stream_id */
+    u64 len_errors;
+};
+
+// pes_type in uapi order: audio, video, teletext, subtitle, PCR per decoder
+static bool aml_dectest_stream_id_ok(enum dmx_ts_pes type, u8 id)
+{
+    switch (type % 5) {
+    case 0:
+        return (id & 0xe0) == 0xc0 || id == 0xbd;
+    case 1:
+        return (id & 0xf0) == 0xe0;
+    case 2:
+    case 3:
+        return id == 0xbd;
+    default:
+        return true;
+    }
+}
+
+static void aml_dectest_pes_start(struct aml_dectest *t,
+                                  struct aml_dvb_dec_stream *st,
+                                  const u8 *p, unsigned int len)
+{
+    if (t->in_pes && t->pes_len && t->pes_got != t->pes_len)
+        t->len_errors++;
+
+    t->in_pes = false;
+    if (len < 9 || p[0] || p[1] || p[2] != 1 ||
+        !aml_dectest_stream_id_ok(st->pes_type, p[3])) {
+        t->bad_starts++;
+        return;
+    }
+
+    t->in_pes = true;
+    t->pes_len = (p[4] << 8 | p[5]);
+    if (t->pes_len)
+        t->pes_len += 6;
+    t->pes_got = 0;
+    t->pes++;
+}
+
+static void aml_dectest_packet(struct aml_dectest *t,
+                               struct aml_dvb_dec_stream *st, const u8 *p)
+{
+    unsigned int off = 4, afc = (p[3] >> 4) & 3, cc = p[3] & 0x0f;
+
+    t->packets++;
+
+    if (p[0] != 0x47 || (p[1] & 0x80) ||
+        ((p[1] & 0x1f) << 8 | p[2]) != st->pid) {
+        t->bad_packets++;
+        t->cc_valid = false;
+        return;
+    }
+
+    if (!(afc & 1))
+        return;                 /* no payload, CC does not count */
+
+    if (t->cc_valid && cc != t->cc && cc != ((t->cc + 1) & 0x0f))
+        t->cc_errors++;
+    t->cc = cc;
+    t->cc_valid = true;
+
+    if (afc == 3)
+        off += 1 + p[4];
+    if (off > TS_PACKET_SIZE) {
+        t->bad_packets++;
+        return;
+    }
+
+    // PCR feeds carry no PES
+    if (st->pes_type % 5 == 4)
+        return;
+
+    if (p[1] & 0x40)
+        aml_dectest_pes_start(t, st, p + off, TS_PACKET_SIZE - off);
+
+    if (t->in_pes) {
+        t->pes_got += TS_PACKET_SIZE - off;
+        t->bytes += TS_PACKET_SIZE - off;
+    }
+}
+
+static int aml_dectest_open(struct aml_dvb_dec_stream *st)
+{
+    st->priv = kzalloc(sizeof(struct aml_dectest), GFP_KERNEL);
+    return st->priv ? 0 : -ENOMEM;
+}
+
+static void aml_dectest_write(struct aml_dvb_dec_stream *st, const u8 *pkts,
+                              unsigned int count)
+{
+    struct aml_dectest *t = st->priv;
+    unsigned int i;
+
+    t->runs++;
+    for (i = 0; i < count; i++)
+        aml_dectest_packet(t, st, pkts + i * TS_PACKET_SIZE);
+}
+
+static int aml_dectest_show(struct aml_dvb_dec_stream *st, char *buf,
+                            size_t size)
+{
+    struct aml_dectest *t = st->priv;
+
+    return scnprintf(buf, size,
+                     "pes=%llu bytes=%llu cc_errors=%llu bad_packets=%llu bad_starts=%llu len_errors=%llu",
+                     t->pes, t->bytes, t->cc_errors, t->bad_packets,
+                     t->bad_starts, t->len_errors);
+}
+
+static void aml_dectest_close(struct aml_dvb_dec_stream *st)
+{
+    struct aml_dectest *t = st->priv;
+
+    dvb_info(st->dvb,
+             "decoder test PID %u: %llu packets in %llu runs, %llu PES, errors cc %llu packet %llu start %llu length %llu\n",
+             st->pid, t->packets, t->runs, t->pes, t->cc_errors,
+             t->bad_packets, t->bad_starts, t->len_errors);
+    kfree(t);
+}
+
+static const struct aml_dvb_dec_sink_ops aml_dectest_ops = {
+    .open = aml_dectest_open,
+    .write = aml_dectest_write,
+    .close = aml_dectest_close,
+    .show = aml_dectest_show,
+};
+
+static struct aml_dvb_dec_sink aml_dectest_sink = {
+    .name = "test",
+    .ops = &aml_dectest_ops,
+    .owner = THIS_MODULE,
+};
+
+static int __init aml_dectest_init(void)
+{
+    return aml_dvb_dec_sink_register(&aml_dectest_sink);
+}
+
+static void __exit aml_dectest_exit(void)
+{
+    aml_dvb_dec_sink_unregister(&aml_dectest_sink);
+}
+
+module_init(aml_dectest_init);
+module_exit(aml_dectest_exit);
+
+MODULE_DESCRIPTION("Amlogic DVB Test Decoder Sink");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,311 @@
+// sources/aml_dvb/aml_dvb_dma.c
+// TS DMA ring consumer
+//
+// The hardware writes TS packets into a circular coherent buffer and
+// advances TS_DMA_WR_PTR; everything between our read offset and the
+// write pointer is handed to the software demux. Besides DMA-done, the
+// ring is drained on the DMA timeout interrupt (or a fallback timer) so
+// a low-bitrate service never waits more than max_latency_ms.
+
+#include <linux/module.h>
+#include <linux/dma-mapping.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
+#include <linux/sizes.h>
+#include <linux/timekeeping.h>
+#include "aml_dvb.h"
+
+static unsigned int max_latency_ms = 40;
+module_param(max_latency_ms, uint, 0444);
+MODULE_PARM_DESC(max_latency_ms,
+                 "Initial flush of partial DMA segments after this many ms (0 = off, sysfs max_latency_ms changes it live)");
+
+static unsigned int dma_buffer_kb = TS_BUFFER_SIZE / 1024;
+module_param(dma_buffer_kb, uint, 0444);
+MODULE_PARM_DESC(dma_buffer_kb,
+                 "Initial DMA ring size in KB (sysfs dma_buffer_kb changes it live)");
+
+static unsigned int irq_coalesce_us = 1000;
+module_param(irq_coalesce_us, uint, 0444);
+MODULE_PARM_DESC(irq_coalesce_us,
+                 "Initial min gap between DMA-done interrupts in us (0 = off)");
+
+static bool dma_sg;
+module_param(dma_sg, bool, 0444);
+MODULE_PARM_DESC(dma_sg, "Initial DMA scatter-gather mode");
+
+static bool dma_timeout_hw = true;
+module_param(dma_timeout_hw, bool, 0444);
+MODULE_PARM_DESC(dma_timeout_hw,
+                 "Use the DMA timeout interrupt (else a fallback timer)");
+
+// Hand [from, from + len) of the ring to the demux. Whole packets only;
+// @first is the index of the first packet within the current drain.
+static void aml_dvb_dma_deliver(struct aml_dvb *dvb, size_t from, size_t len,
+                                unsigned int first)
+{
+    const u8 *buf = dvb->dma_buf + from;
+    unsigned int count = len / TS_PACKET_SIZE;
+
+    // TS input autodetection owns the ring while it measures
+    if (aml_dvb_tsdetect_count(dvb, buf, count))
+        return;
+
+    if (unlikely(!dvb->bringup.first_data_ns))
+        dvb->bringup.first_data_ns = ktime_get_boottime_ns();
+
+    aml_dvb_tsstamp_chunk(dvb, buf, first, count);
+    aml_dvr_fanout_write(dvb, buf, count * TS_PACKET_SIZE);
+    aml_dvb_decoder_swfilter(dvb, buf, count);
+}
+
+// Drain the ring up to the hardware write pointer. Safe from IRQ and timer.
+void aml_dvb_dma_process(struct aml_dvb *dvb)
+{
+    unsigned long flags;
+    size_t wr, rd, len;
+
+    spin_lock_irqsave(&dvb->dma_lock, flags);
+
+    wr = aml_dvb_reg_dma_wr_offset(dvb);
+    wr -= wr % TS_PACKET_SIZE;
+    rd = dvb->dma_rd;
+
+    // wr == dma_size: the DMA filled up to END_ADDR and has not wrapped
+    if (wr == rd || wr > dvb->dma_size)
+        goto out;
+
+    len = wr > rd ? wr - rd : dvb->dma_size - rd + wr;
+
+    // One clock sample per drain, interpolated per packet
+    aml_dvb_tsstamp_segment(dvb, len / TS_PACKET_SIZE);
+
+    if (wr > rd) {
+        aml_dvb_dma_deliver(dvb, rd, len, 0);
+    } else {
+        aml_dvb_dma_deliver(dvb, rd, dvb->dma_size - rd, 0);
+        if (wr)
+            aml_dvb_dma_deliver(dvb, 0, wr,
+                                (dvb->dma_size - rd) / TS_PACKET_SIZE);
+    }
+
+    if (wr == dvb->dma_size)
+        wr = 0;
+    dvb->dma_rd = wr;
+    dvb->dma_stats.bytes += len;
+    aml_dvb_reg_dma_set_rd_offset(dvb, wr);
+out:
+    spin_unlock_irqrestore(&dvb->dma_lock, flags);
+}
+EXPORT_SYMBOL(aml_dvb_dma_process);
+
+// Interrupt status from the IRQ handler
+irqreturn_t aml_dvb_dma_irq(struct aml_dvb *dvb)
+{
+    u32 status = aml_dvb_reg_irq_status(dvb);
+
+    if (!status)
+        return IRQ_NONE;
+
+    if (status & AML_DVB_IRQ_DMA_DONE)
+        dvb->dma_stats.irqs++;
+    if (status & AML_DVB_IRQ_TIMEOUT)
+        dvb->dma_stats.timeouts++;
+    if (status & AML_DVB_IRQ_OVERFLOW)
+        dvb->dma_stats.overflows++;
+
+    if (status & (AML_DVB_IRQ_DMA_DONE | AML_DVB_IRQ_TIMEOUT))
+        aml_dvb_dma_process(dvb);
+
+    aml_dvb_reg_irq_ack(dvb, status);
+
+    return IRQ_HANDLED;
+}
+EXPORT_SYMBOL(aml_dvb_dma_irq);
+
+static enum hrtimer_restart aml_dvb_dma_timer(struct hrtimer *timer)
+{
+    struct aml_dvb *dvb = container_of(timer, struct aml_dvb, dma_timer);
+    unsigned int ms;
+
+    dvb->dma_stats.timeouts++;
+    aml_dvb_dma_process(dvb);
+
+    // A zero period would fire again at once, forever
+    ms = READ_ONCE(dvb->max_latency_ms);
+    if (!ms)
+        return HRTIMER_NORESTART;
+
+    hrtimer_forward_now(timer, ms_to_ktime(ms));
+    return HRTIMER_RESTART;
+}
+
+// Arm the latency bound: the DMA timeout interrupt, else the timer
+static void aml_dvb_dma_latency_start(struct aml_dvb *dvb)
+{
+    unsigned int ms = dvb->max_latency_ms;
+
+    if (ms && dma_timeout_hw && dvb->variant->dma_timeout) {
+        aml_dvb_reg_set_dma_timeout(dvb, ms * USEC_PER_MSEC);
+    } else {
+        aml_dvb_reg_set_dma_timeout(dvb, 0);
+        if (ms)
+            hrtimer_start(&dvb->dma_timer, ms_to_ktime(ms),
+                          HRTIMER_MODE_REL_SOFT);
+    }
+}
+
+/* Ring sizes are whole packets, within 32 KB .. the variant's limit */
+static size_t aml_dvb_dma_ring_size(struct aml_dvb *dvb, size_t size)
+{
+    size = clamp_t(size_t, size, SZ_32K, dvb->variant->dma_max);
+    return size - size % TS_PACKET_SIZE;
+}
+
+int aml_dvb_dma_init(struct aml_dvb *dvb)
+{
+    hrtimer_init(&dvb->dma_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_SOFT);
+    dvb->dma_timer.function = aml_dvb_dma_timer;
+    dvb->irq_coalesce_us = irq_coalesce_us;
+    dvb->max_latency_ms = max_latency_ms;
+    dvb->dma_sg = dma_sg && dvb->variant->dma_sg;
+
+    /* Allocate DMA buffer - kernel 6.x compatible */
+    dvb->dma_size = aml_dvb_dma_ring_size(dvb, (size_t)dma_buffer_kb * 1024);
+    dvb->dma_buf = dma_alloc_coherent(dvb->dev, dvb->dma_size,
+                                      &dvb->dma_addr, GFP_KERNEL);
+    if (!dvb->dma_buf) {
+        dev_err(dvb->dev, "Failed to allocate DMA buffer\n");
+        return -ENOMEM;
+    }
+
+    return 0;
+}
+EXPORT_SYMBOL(aml_dvb_dma_init);
+
+void aml_dvb_dma_exit(struct aml_dvb *dvb)
+{
+    aml_dvb_dma_stop(dvb);
+
+    if (dvb->dma_buf) {
+        dma_free_coherent(dvb->dev, dvb->dma_size,
+                          dvb->dma_buf, dvb->dma_addr);
+        dvb->dma_buf = NULL;
+    }
+}
+EXPORT_SYMBOL(aml_dvb_dma_exit);
+
+void aml_dvb_dma_start(struct aml_dvb *dvb)
+{
+    unsigned long flags;
+
+    // The IRQ may already be enabled and draining
+    spin_lock_irqsave(&dvb->dma_lock, flags);
+    dvb->dma_rd = 0;
+    spin_unlock_irqrestore(&dvb->dma_lock, flags);
+
+    aml_dvb_reg_setup_dma(dvb, dvb->dma_addr, dvb->dma_size);
+    aml_dvb_reg_set_irq_coalesce(dvb, dvb->irq_coalesce_us);
+    aml_dvb_dma_latency_start(dvb);
+    aml_dvb_reg_start_dma(dvb);
+}
+EXPORT_SYMBOL(aml_dvb_dma_start);
+
+void aml_dvb_dma_stop(struct aml_dvb *dvb)
+{
+    hrtimer_cancel(&dvb->dma_timer);
+    aml_dvb_reg_stop_dma(dvb);
+}
+EXPORT_SYMBOL(aml_dvb_dma_stop);
+
+/*
+ * Change the latency bound on a live adapter. Only the timeout register
+ * or the fallback timer is touched; the ring keeps running.
+ */
+int aml_dvb_dma_set_latency(struct aml_dvb *dvb, unsigned int ms)
+{
+    int ret;
+
+    ret = aml_dvb_pm_get(dvb);
+    if (ret)
+        return ret;
+
+    mutex_lock(&dvb->dma_cfg_lock);
+    hrtimer_cancel(&dvb->dma_timer);
+    WRITE_ONCE(dvb->max_latency_ms, ms);
+    aml_dvb_dma_latency_start(dvb);
+    mutex_unlock(&dvb->dma_cfg_lock);
+
+    aml_dvb_pm_put(dvb);
+    return 0;
+}
+EXPORT_SYMBOL(aml_dvb_dma_set_latency);
+
+/*
+ * Change ring size, interrupt coalescing and SG mode on a live adapter.
+ * DMA is quiesced, what is already in the ring is delivered, and the
+ * ring restarts; the demux and open file descriptors are untouched.
+ * The new ring is allocated first: if that fails, nothing is changed and
+ * DMA keeps running as it was. This is the primary (demux0) ring only;
+ * the secondary channels keep their fixed TS_BUFFER_SIZE rings.
+ */
+int aml_dvb_dma_reconfig(struct aml_dvb *dvb, size_t size, u32 coalesce_us,
+                         bool sg)
+{
+    dma_addr_t addr, old_addr;
+    void *buf = NULL, *old_buf;
+    size_t old_size;
+    int ret;
+
+    // Nothing to reconfigure until the first ring exists; powered meanwhile
+    ret = aml_dvb_pm_get(dvb);
+    if (ret)
+        return ret;
+
+    size = aml_dvb_dma_ring_size(dvb, size);
+    sg = sg && dvb->variant->dma_sg;
+
+    mutex_lock(&dvb->dma_cfg_lock);
+
+    if (size != dvb->dma_size) {
+        buf = dma_alloc_coherent(dvb->dev, size, &addr, GFP_KERNEL);
+        if (!buf) {
+            mutex_unlock(&dvb->dma_cfg_lock);
+            aml_dvb_pm_put(dvb);
+            return -ENOMEM;
+        }
+    }
+
+    aml_dvb_dma_stop(dvb);
+    synchronize_irq(dvb->irq);
+    aml_dvb_dma_process(dvb);
+
+    old_buf = dvb->dma_buf;
+    old_addr = dvb->dma_addr;
+    old_size = dvb->dma_size;
+
+    spin_lock_irq(&dvb->dma_lock);
+    if (buf) {
+        dvb->dma_buf = buf;
+        dvb->dma_addr = addr;
+        dvb->dma_size = size;
+    }
+    dvb->irq_coalesce_us = coalesce_us;
+    dvb->dma_sg = sg;
+    spin_unlock_irq(&dvb->dma_lock);
+
+    aml_dvb_dma_start(dvb);
+    mutex_unlock(&dvb->dma_cfg_lock);
+    aml_dvb_pm_put(dvb);
+
+    if (buf) {
+        dma_free_coherent(dvb->dev, old_size, old_buf, old_addr);
+        dvb_info(dvb, "DMA ring resized to %zu bytes\n", size);
+    }
+
+    return 0;
+}
+EXPORT_SYMBOL(aml_dvb_dma_reconfig);
+
+MODULE_DESCRIPTION("Amlogic DVB DMA Ring");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,602 @@
+// sources/aml_dvb/aml_dvb_fe_i2c.c
+// Cached register access for the frontend's I2C map
+//
+// The M88RS6060 driver (out of tree, patches/002) issues one I2C
+// transfer per register, on every tune and every stats poll. Instead of
+// the AO bus it is handed a small i2c_adapter of ours that maps its
+// [reg, data...] writes and [reg] + read transfers for the demod address
+// onto a regmap with a register cache:
+//
+//  - status, AGC, SNR/BER counters and the I2C repeater are volatile and
+//    always go to the chip; everything else is served from the cache
+//    once it has been read or written
+//  - a single-register write of the value already in the cache is
+//    dropped; a multi-register burst always goes out whole
+//  - consecutive single-register writes in one transfer go out as one
+//    auto-increment write
+//  - the firmware download FIFO and the DiSEqC trigger are ports, not
+//    registers: writes to them always reach the chip, are never merged,
+//    and a burst into one is not taken for the registers after it
+//
+// Other addresses (the tuner behind the repeater) pass straight through.
+// The cache is dropped on frontend init, as the chip may have been reset.
+// With no parent adapter the chip is emulated by a plain register file
+// and bus time is modelled, which the tune benchmark uses as a stand-in.
+
+#include <linux/module.h>
+#include <linux/i2c.h>
+#include <linux/regmap.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include "aml_dvb.h"
+
+static bool fe_regcache = true;
+module_param(fe_regcache, bool, 0644);
+MODULE_PARM_DESC(fe_regcache,
+                 "Cache frontend registers (0 = every access goes to the bus)");
+
+static unsigned int fe_i2c_khz = 400;
+module_param(fe_i2c_khz, uint, 0644);
+MODULE_PARM_DESC(fe_i2c_khz, "Bus clock assumed by the emulated frontend (kHz)");
+
+#define AML_FE_I2C_REGS     256
+#define AML_FE_I2C_BATCH    32      /* m88rs6060 i2c_wr_max is 33 */
+#define AML_FE_I2C_EMU_ADDRS 128
+
+// Montage demod registers that change on their own or act on write
+static const struct regmap_range aml_fe_volatile_ranges[] = {
+    regmap_reg_range(0x03, 0x03),   /* I2C repeater, closes after use */
+    regmap_reg_range(0x07, 0x07),   /* soft reset */
+    regmap_reg_range(0x08, 0x0d),   /* lock and FSM status */
+    regmap_reg_range(0x3d, 0x3f),   /* AGC */
+    regmap_reg_range(0x8c, 0x8f),   /* SNR */
+    regmap_reg_range(0xa1, 0xa1),   /* DiSEqC control and trigger */
+    regmap_reg_range(0xb0, 0xb0),   /* MCU firmware FIFO */
+    regmap_reg_range(0xb2, 0xb2),   /* MCU control */
+    regmap_reg_range(0xd5, 0xf8),   /* BER / FEC counters */
+};
+
+// Ports: every byte written goes into the chip's FIFO or starts an action
+static const struct regmap_range aml_fe_port_ranges[] = {
+    regmap_reg_range(0xa1, 0xa1),   /* DiSEqC control and trigger */
+    regmap_reg_range(0xb0, 0xb0),   /* MCU firmware FIFO */
+};
+
+static const struct regmap_access_table aml_fe_volatile_table = {
+    .yes_ranges = aml_fe_volatile_ranges,
+    .n_yes_ranges = ARRAY_SIZE(aml_fe_volatile_ranges),
+};
+
+static const struct regmap_access_table aml_fe_precious_table = {
+    .yes_ranges = aml_fe_port_ranges,
+    .n_yes_ranges = ARRAY_SIZE(aml_fe_port_ranges),
+};
+
+static bool aml_fe_i2c_volatile(unsigned int reg)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(aml_fe_volatile_ranges); i++)
+        if (regmap_reg_in_range(reg, &aml_fe_volatile_ranges[i]))
+            return true;
+
+    return false;
+}
+
+// A port within [reg, reg + len)
+static bool aml_fe_i2c_port(unsigned int reg, int len)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(aml_fe_port_ranges); i++)
+        if (reg <= aml_fe_port_ranges[i].range_max &&
+            reg + len > aml_fe_port_ranges[i].range_min)
+            return true;
+
+    return false;
+}
+
+// Emulated chip: registers with an auto-incrementing pointer per address
+static void aml_fe_i2c_emulate(struct aml_fe_i2c *fc, struct i2c_msg *msg)
+{
+    u8 *regs = fc->emu + (msg->addr % AML_FE_I2C_EMU_ADDRS) * AML_FE_I2C_REGS;
+    u8 *ptr = &fc->emu_ptr[msg->addr % AML_FE_I2C_EMU_ADDRS];
+    int i;
+
+    if (msg->flags & I2C_M_RD) {
+        for (i = 0; i < msg->len; i++)
+            msg->buf[i] = regs[(*ptr)++];
+    } else if (msg->len) {
+        *ptr = msg->buf[0];
+        for (i = 1; i < msg->len; i++)
+            regs[(*ptr)++] = msg->buf[i];
+    }
+
+    // Start/address/data/stop, 9 clocks per byte
+    fc->stats.bus_ns += (u64)((msg->len + 1) * 9 + 2) * NSEC_PER_MSEC /
+                        max(fe_i2c_khz, 1U);
+}
+
+// One transaction on the real bus (or the emulated chip)
+static int aml_fe_i2c_raw(struct aml_fe_i2c *fc, struct i2c_msg *msgs, int num)
+{
+    ktime_t start;
+    int i, ret;
+
+    fc->stats.xfers++;
+
+    if (!fc->parent) {
+        for (i = 0; i < num; i++)
+            aml_fe_i2c_emulate(fc, &msgs[i]);
+        return num;
+    }
+
+    start = ktime_get();
+    ret = i2c_transfer(fc->parent, msgs, num);
+    fc->stats.bus_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+
+    return ret;
+}
+
+static int aml_fe_regmap_write(void *context, const void *data, size_t count)
+{
+    struct aml_fe_i2c *fc = context;
+    struct i2c_msg msg = {
+        .addr = fc->addr, .flags = 0, .len = count, .buf = (u8 *)data,
+    };
+    int ret;
+
+    ret = aml_fe_i2c_raw(fc, &msg, 1);
+    return ret == 1 ? 0 : ret < 0 ? ret : -EIO;
+}
+
+static int aml_fe_regmap_read(void *context, const void *reg_buf,
+                              size_t reg_size, void *val_buf, size_t val_size)
+{
+    struct aml_fe_i2c *fc = context;
+    struct i2c_msg msgs[2] = {
+        { .addr = fc->addr, .flags = 0, .len = reg_size, .buf = (u8 *)reg_buf },
+        { .addr = fc->addr, .flags = I2C_M_RD, .len = val_size, .buf = val_buf },
+    };
+    int ret;
+
+    ret = aml_fe_i2c_raw(fc, msgs, 2);
+    return ret == 2 ? 0 : ret < 0 ? ret : -EIO;
+}
+
+static const struct regmap_bus aml_fe_regmap_bus = {
+    .write = aml_fe_regmap_write,
+    .read = aml_fe_regmap_read,
+    .max_raw_write = AML_FE_I2C_BATCH,
+};
+
+static const struct regmap_config aml_fe_regmap_config = {
+    .reg_bits = 8,
+    .val_bits = 8,
+    .max_register = AML_FE_I2C_REGS - 1,
+    .volatile_table = &aml_fe_volatile_table,
+    .precious_table = &aml_fe_precious_table,
+    .cache_type = REGCACHE_RBTREE,
+};
+
+static void aml_fe_i2c_invalidate(struct aml_fe_i2c *fc)
+{
+    regcache_drop_region(fc->map, 0, AML_FE_I2C_REGS - 1);
+    bitmap_zero(fc->known, AML_FE_I2C_REGS);
+}
+
+// Cached value of a register the chip cannot change by itself
+static bool aml_fe_i2c_cached(struct aml_fe_i2c *fc, unsigned int reg,
+                              unsigned int *val)
+{
+    if (aml_fe_i2c_volatile(reg) || !test_bit(reg, fc->known))
+        return false;
+
+    return !regmap_read(fc->map, reg, val);
+}
+
+// Single-register write the cache already holds
+static bool aml_fe_i2c_unchanged(struct aml_fe_i2c *fc, struct i2c_msg *m)
+{
+    unsigned int val;
+
+    return m->len == 2 && aml_fe_i2c_cached(fc, m->buf[0], &val) &&
+           val == m->buf[1];
+}
+
+// A burst goes out whole: the driver may rely on every byte reaching the chip
+static int aml_fe_i2c_write(struct aml_fe_i2c *fc, u8 reg, const u8 *vals,
+                            int len)
+{
+    int i, ret;
+
+    ret = regmap_raw_write(fc->map, reg, vals, len);
+    if (ret)
+        return ret;
+
+    for (i = 0; i < len; i++)
+        if (!aml_fe_i2c_volatile(reg + i))
+            set_bit(reg + i, fc->known);
+
+    return 0;
+}
+
+static int aml_fe_i2c_read(struct aml_fe_i2c *fc, u8 reg, u8 *buf, int len)
+{
+    unsigned int val;
+    int i, ret;
+
+    for (i = 0; i < len; i++) {
+        if (!aml_fe_i2c_cached(fc, reg + i, &val))
+            break;
+        buf[i] = val;
+    }
+
+    if (i == len) {
+        fc->stats.read_hits += len;
+        return 0;
+    }
+
+    // Any miss: one bus read for the whole span, then keep what may be kept
+    ret = aml_fe_regmap_read(fc, &reg, 1, buf, len);
+    if (ret)
+        return ret;
+
+    regcache_cache_only(fc->map, true);
+    for (i = 0; i < len; i++) {
+        if (aml_fe_i2c_volatile(reg + i))
+            continue;
+        regmap_write(fc->map, reg + i, buf[i]);
+        set_bit(reg + i, fc->known);
+    }
+    regcache_cache_only(fc->map, false);
+
+    return 0;
+}
+
+// Single-register writes to consecutive registers: one bus write
+static int aml_fe_i2c_write_run(struct aml_fe_i2c *fc, struct i2c_msg *msgs,
+                                int num)
+{
+    u8 batch[AML_FE_I2C_BATCH];
+    u8 reg = msgs[0].buf[0];
+    int len = msgs[0].len - 1;
+    int n, ret;
+
+    // Wraps past the last register: the cache cannot follow
+    if (reg + len > AML_FE_I2C_REGS) {
+        aml_fe_i2c_invalidate(fc);
+        ret = aml_fe_i2c_raw(fc, msgs, 1);
+        return ret < 0 ? ret : 1;
+    }
+
+    // FIFO or trigger: as is, and whatever follows it is not known
+    if (aml_fe_i2c_port(reg, len)) {
+        regcache_drop_region(fc->map, reg, reg + len - 1);
+        for (n = 0; n < len; n++)
+            clear_bit(reg + n, fc->known);
+        ret = aml_fe_i2c_raw(fc, msgs, 1);
+        return ret < 0 ? ret : 1;
+    }
+
+    if (aml_fe_i2c_unchanged(fc, msgs)) {
+        fc->stats.write_skips++;
+        return 1;
+    }
+
+    if (len > AML_FE_I2C_BATCH)
+        return aml_fe_i2c_write(fc, reg, msgs[0].buf + 1, len) ?: 1;
+
+    memcpy(batch, msgs[0].buf + 1, len);
+
+    for (n = 1; n < num; n++) {
+        struct i2c_msg *m = &msgs[n];
+
+        if (m->addr != fc->addr || (m->flags & I2C_M_RD) || m->len < 2 ||
+            m->buf[0] != reg + len || len + m->len - 1 > AML_FE_I2C_BATCH ||
+            aml_fe_i2c_port(m->buf[0], m->len - 1) ||
+            aml_fe_i2c_unchanged(fc, m))
+            break;
+
+        memcpy(batch + len, m->buf + 1, m->len - 1);
+        len += m->len - 1;
+        fc->stats.merged++;
+    }
+
+    return aml_fe_i2c_write(fc, reg, batch, len) ?: n;
+}
+
+static int aml_fe_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg *msgs,
+                           int num)
+{
+    struct aml_fe_i2c *fc = i2c_get_adapdata(adap);
+    bool cache = fc->parent ? READ_ONCE(fe_regcache) : fc->cache;
+    int i = 0, n, ret;
+
+    if (!cache) {
+        fc->stale = true;
+        return aml_fe_i2c_raw(fc, msgs, num);
+    }
+
+    // Writes went past the cache while it was off
+    if (fc->stale) {
+        aml_fe_i2c_invalidate(fc);
+        fc->stale = false;
+    }
+
+    while (i < num) {
+        struct i2c_msg *m = &msgs[i];
+
+        if (m->addr != fc->addr) {
+            // Other chips (tuner behind the repeater): forward as is
+            for (n = 1; i + n < num && msgs[i + n].addr == m->addr; n++)
+                ;
+            ret = aml_fe_i2c_raw(fc, m, n);
+        } else if (!(m->flags & I2C_M_RD) && m->len == 1 && i + 1 < num &&
+                   msgs[i + 1].addr == m->addr &&
+                   (msgs[i + 1].flags & I2C_M_RD) &&
+                   m->buf[0] + msgs[i + 1].len <= AML_FE_I2C_REGS) {
+            ret = aml_fe_i2c_read(fc, m->buf[0], msgs[i + 1].buf,
+                                  msgs[i + 1].len);
+            n = 2;
+        } else if (!(m->flags & I2C_M_RD) && m->len >= 2) {
+            ret = n = aml_fe_i2c_write_run(fc, m, num - i);
+        } else {
+            // Bare pointer write or read: the cache cannot follow
+            aml_fe_i2c_invalidate(fc);
+            ret = aml_fe_i2c_raw(fc, m, 1);
+            n = 1;
+        }
+
+        if (ret < 0)
+            return ret;
+        i += n;
+    }
+
+    return num;
+}
+
+static u32 aml_fe_i2c_func(struct i2c_adapter *adap)
+{
+    return I2C_FUNC_I2C;
+}
+
+static const struct i2c_algorithm aml_fe_i2c_algo = {
+    .master_xfer = aml_fe_i2c_xfer,
+    .functionality = aml_fe_i2c_func,
+};
+
+// @parent NULL: emulated chip, adapter not registered with the I2C core
+int aml_fe_i2c_init(struct aml_fe_i2c *fc, struct device *dev,
+                    struct i2c_adapter *parent, u16 addr, const char *name)
+{
+    struct regmap_config cfg = aml_fe_regmap_config;
+    int ret;
+
+    fc->parent = parent;
+    fc->addr = addr;
+    fc->cache = true;
+    bitmap_zero(fc->known, AML_FE_I2C_REGS);
+    memset(&fc->stats, 0, sizeof(fc->stats));
+
+    if (!parent) {
+        fc->emu = kzalloc(AML_FE_I2C_EMU_ADDRS * AML_FE_I2C_REGS, GFP_KERNEL);
+        if (!fc->emu)
+            return -ENOMEM;
+    }
+
+    cfg.name = name;
+    fc->map = regmap_init(dev, &aml_fe_regmap_bus, fc, &cfg);
+    if (IS_ERR(fc->map)) {
+        ret = PTR_ERR(fc->map);
+        goto err_free;
+    }
+
+    fc->adap.owner = THIS_MODULE;
+    fc->adap.algo = &aml_fe_i2c_algo;
+    fc->adap.dev.parent = dev;
+    snprintf(fc->adap.name, sizeof(fc->adap.name), "aml-dvb %s", name);
+    i2c_set_adapdata(&fc->adap, fc);
+
+    if (!parent)
+        return 0;
+
+    ret = i2c_add_adapter(&fc->adap);
+    if (ret)
+        goto err_regmap;
+
+    return 0;
+
+err_regmap:
+    regmap_exit(fc->map);
+err_free:
+    fc->map = NULL;
+    kfree(fc->emu);
+    fc->emu = NULL;
+    return ret;
+}
+EXPORT_SYMBOL(aml_fe_i2c_init);
+
+void aml_fe_i2c_exit(struct aml_fe_i2c *fc)
+{
+    if (!fc->map)
+        return;
+
+    if (fc->parent)
+        i2c_del_adapter(&fc->adap);
+    regmap_exit(fc->map);
+    fc->map = NULL;
+    kfree(fc->emu);
+    fc->emu = NULL;
+}
+EXPORT_SYMBOL(aml_fe_i2c_exit);
+
+static struct aml_fe_i2c *aml_fe_i2c_from_fe(struct dvb_frontend *fe)
+{
+    struct aml_dvb *dvb = container_of(fe->dvb, struct aml_dvb, adapter);
+
+    return &dvb->fe_i2c;
+}
+
+// Chip may have been powered down or reset since the last use
+static int aml_fe_i2c_fe_init(struct dvb_frontend *fe)
+{
+    struct aml_fe_i2c *fc = aml_fe_i2c_from_fe(fe);
+
+    i2c_lock_bus(&fc->adap, I2C_LOCK_ROOT_ADAPTER);
+    aml_fe_i2c_invalidate(fc);
+    i2c_unlock_bus(&fc->adap, I2C_LOCK_ROOT_ADAPTER);
+
+    return fc->init ? fc->init(fe) : 0;
+}
+
+static int aml_fe_i2c_set_frontend(struct dvb_frontend *fe)
+{
+    struct aml_fe_i2c *fc = aml_fe_i2c_from_fe(fe);
+    u64 xfers = fc->stats.xfers;
+    ktime_t start = ktime_get();
+    int ret;
+
+    ret = fc->set_frontend(fe);
+
+    fc->stats.tunes++;
+    fc->stats.tune_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+    fc->stats.tune_xfers = fc->stats.xfers - xfers;
+    return ret;
+}
+
+// Drop the cache on init and account bus traffic and time per tune
+void aml_fe_i2c_hook(struct aml_fe_i2c *fc, struct dvb_frontend *fe)
+{
+    fc->init = fe->ops.init;
+    fe->ops.init = aml_fe_i2c_fe_init;
+
+    if (fe->ops.set_frontend) {
+        fc->set_frontend = fe->ops.set_frontend;
+        fe->ops.set_frontend = aml_fe_i2c_set_frontend;
+    }
+}
+EXPORT_SYMBOL(aml_fe_i2c_hook);
+
+/*
+ * Tune benchmark on the emulated chip. The access pattern follows a
+ * Montage demod tune: soft reset, a fixed register table, read-modify-
+ * write of mode bits, symbol rate and carrier offset in one transfer,
+ * tuner programming through the repeater, then lock/AGC polling.
+ */
+#define AML_FE_BENCH_DEMOD  0x69
+#define AML_FE_BENCH_TUNER  0x2c
+#define AML_FE_BENCH_POLLS  10
+
+static const u8 aml_fe_bench_table[][2] = {
+    { 0x23, 0x07 }, { 0x08, 0x03 }, { 0x0c, 0x02 }, { 0x21, 0x54 },
+    { 0x25, 0x8a }, { 0x27, 0x31 }, { 0x30, 0x08 }, { 0x31, 0x40 },
+    { 0x32, 0x32 }, { 0x33, 0x35 }, { 0x35, 0xff }, { 0x3a, 0x00 },
+    { 0x37, 0x10 }, { 0x38, 0x10 }, { 0x39, 0x02 }, { 0x42, 0x60 },
+    { 0x4a, 0x80 }, { 0x4b, 0x04 }, { 0x4d, 0x91 }, { 0x5d, 0xc8 },
+    { 0x50, 0x36 }, { 0x51, 0x36 }, { 0x52, 0x36 }, { 0x53, 0x36 },
+    { 0x56, 0x01 }, { 0x63, 0x0f }, { 0x64, 0x30 }, { 0x65, 0x40 },
+    { 0x68, 0x26 }, { 0x69, 0x4c }, { 0x70, 0x20 }, { 0x71, 0x70 },
+};
+
+static int aml_fe_bench_write(struct aml_fe_i2c *fc, u16 addr, u8 reg, u8 val)
+{
+    u8 buf[2] = { reg, val };
+    struct i2c_msg msg = { .addr = addr, .len = 2, .buf = buf };
+
+    return aml_fe_i2c_xfer(&fc->adap, &msg, 1);
+}
+
+static int aml_fe_bench_read(struct aml_fe_i2c *fc, u8 reg, u8 *val, int len)
+{
+    struct i2c_msg msgs[2] = {
+        { .addr = AML_FE_BENCH_DEMOD, .len = 1, .buf = &reg },
+        { .addr = AML_FE_BENCH_DEMOD, .flags = I2C_M_RD, .len = len,
+          .buf = val },
+    };
+
+    return aml_fe_i2c_xfer(&fc->adap, msgs, 2);
+}
+
+static int aml_fe_bench_tune(struct aml_fe_i2c *fc, unsigned int n)
+{
+    u8 sr[4][2] = {
+        { 0x61, n & 0xff }, { 0x62, 0x40 }, { 0x63, 0x0f }, { 0x64, n >> 8 },
+    };
+    struct i2c_msg msgs[4];
+    u8 val[3];
+    int i, ret = 0;
+
+    ret |= aml_fe_bench_write(fc, AML_FE_BENCH_DEMOD, 0x07, 0x80);
+    ret |= aml_fe_bench_write(fc, AML_FE_BENCH_DEMOD, 0x07, 0x00);
+
+    for (i = 0; i < ARRAY_SIZE(aml_fe_bench_table); i++)
+        ret |= aml_fe_bench_write(fc, AML_FE_BENCH_DEMOD,
+                                  aml_fe_bench_table[i][0],
+                                  aml_fe_bench_table[i][1]);
+
+    ret |= aml_fe_bench_read(fc, 0x22, val, 1);
+    ret |= aml_fe_bench_write(fc, AML_FE_BENCH_DEMOD, 0x22, val[0] | 0x40);
+    ret |= aml_fe_bench_read(fc, 0x24, val, 1);
+    ret |= aml_fe_bench_write(fc, AML_FE_BENCH_DEMOD, 0x24, val[0] & ~0x01);
+
+    for (i = 0; i < ARRAY_SIZE(sr); i++) {
+        msgs[i].addr = AML_FE_BENCH_DEMOD;
+        msgs[i].flags = 0;
+        msgs[i].len = 2;
+        msgs[i].buf = sr[i];
+    }
+    ret |= aml_fe_i2c_xfer(&fc->adap, msgs, ARRAY_SIZE(msgs));
+
+    ret |= aml_fe_bench_write(fc, AML_FE_BENCH_DEMOD, 0x03, 0x11);
+    for (i = 0; i < 6; i++)
+        ret |= aml_fe_bench_write(fc, AML_FE_BENCH_TUNER, 0x10 + i, n + i);
+
+    for (i = 0; i < AML_FE_BENCH_POLLS; i++) {
+        ret |= aml_fe_bench_read(fc, 0x0d, val, 1);
+        ret |= aml_fe_bench_read(fc, 0x3d, val, 3);
+        ret |= aml_fe_bench_read(fc, 0x30, val, 2);
+    }
+
+    return ret < 0 ? -EIO : 0;
+}
+
+// Same tune sequence uncached ([0]) and cached ([1]) on fresh chips
+int aml_fe_i2c_bench(struct aml_dvb *dvb, unsigned int tunes)
+{
+    static DEFINE_MUTEX(bench_lock);
+    struct aml_fe_i2c_bench *b = &dvb->fe_bench;
+    struct aml_fe_i2c *fc;
+    unsigned int i;
+    int mode, ret = 0;
+
+    fc = kzalloc(sizeof(*fc), GFP_KERNEL);
+    if (!fc)
+        return -ENOMEM;
+
+    mutex_lock(&bench_lock);
+    for (mode = 0; mode < 2 && !ret; mode++) {
+        memset(fc, 0, sizeof(*fc));
+        ret = aml_fe_i2c_init(fc, dvb->dev, NULL, AML_FE_BENCH_DEMOD,
+                              mode ? "fe-bench-cached" : "fe-bench");
+        if (ret)
+            break;
+
+        fc->cache = mode;
+        for (i = 0; i < tunes && !ret; i++)
+            ret = aml_fe_bench_tune(fc, i);
+
+        b->xfers[mode] = fc->stats.xfers;
+        b->bus_ns[mode] = fc->stats.bus_ns;
+        aml_fe_i2c_exit(fc);
+    }
+    b->tunes = ret ? 0 : tunes;
+    mutex_unlock(&bench_lock);
+
+    kfree(fc);
+    return ret;
+}
+EXPORT_SYMBOL(aml_fe_i2c_bench);
+
+MODULE_DESCRIPTION("Amlogic DVB Frontend Register Cache");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,358 @@
+// sources/aml_dvb/aml_dvb_fe_lock.c
+// Fast lock detection and cached signal statistics for the frontend
+//
+// The frontend is switched to DVBFE_ALGO_HW with our tune() in front of
+// the driver's, which lets us pick the frontend thread's sleep between
+// polls: right after a (re)tune the demod is polled at
+// fe_lock_poll_min_ms, doubling up to fe_lock_poll_max_ms, and lock is
+// reported by dvb-core the moment a poll sees it. Once locked the thread
+// polls every fe_stats_ms and samples status and statistics there, once.
+// FE_READ_STATUS and the FE_READ_* statistics ioctls are answered from
+// that sample and never touch the bus; DTV_STAT_* are already served from
+// the property cache the driver fills during the same read_status().
+//
+// M88RS6060 boards have no lock interrupt wired, so polling is the only
+// event source here.
+//
+// A blind scan takes the demod exclusively. The frontend device and a
+// scan exclude each other through ts_bus_ctrl (first open, last close),
+// and the demod mutex keeps the scan and the frontend thread's tune and
+// sleep apart while the thread winds down after the last close.
+
+#include <linux/module.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/wait.h>
+#include <media/dvb_frontend.h>
+#include "aml_dvb.h"
+
+static unsigned int fe_lock_poll_min_ms = 5;
+module_param(fe_lock_poll_min_ms, uint, 0644);
+MODULE_PARM_DESC(fe_lock_poll_min_ms, "First lock poll after a tune (ms)");
+
+static unsigned int fe_lock_poll_max_ms = 100;
+module_param(fe_lock_poll_max_ms, uint, 0644);
+MODULE_PARM_DESC(fe_lock_poll_max_ms, "Slowest lock poll while not locked (ms)");
+
+static unsigned int fe_stats_ms = 1000;
+module_param(fe_stats_ms, uint, 0644);
+MODULE_PARM_DESC(fe_stats_ms, "Status and statistics sampling while locked (ms)");
+
+// How long a scan waits for the frontend thread to put the demod to sleep
+#define AML_FE_LOCK_EXIT_MS     1000
+
+static struct aml_fe_lock *aml_fe_lock_from_fe(struct dvb_frontend *fe)
+{
+    struct aml_dvb *dvb = container_of(fe->dvb, struct aml_dvb, adapter);
+
+    return &dvb->fe_lock;
+}
+
+// Driver statistics, one bus round per sampling interval
+static void aml_fe_lock_sample(struct dvb_frontend *fe, struct aml_fe_lock *fl)
+{
+    u16 strength = 0, snr = 0;
+    u32 ber = 0, ucb = 0;
+
+    if (fl->read_signal_strength)
+        fl->read_signal_strength(fe, &strength);
+    if (fl->read_snr)
+        fl->read_snr(fe, &snr);
+    if (fl->read_ber)
+        fl->read_ber(fe, &ber);
+    if (fl->read_ucblocks)
+        fl->read_ucblocks(fe, &ucb);
+
+    spin_lock(&fl->lock);
+    fl->strength = strength;
+    fl->snr = snr;
+    fl->ber = ber;
+    fl->ucb = ucb;
+    spin_unlock(&fl->lock);
+}
+
+static enum dvbfe_algo aml_fe_lock_algo(struct dvb_frontend *fe)
+{
+    return DVBFE_ALGO_HW;
+}
+
+// Frontend thread: tune on request, poll lock, choose the next delay
+static int aml_fe_lock_tune(struct dvb_frontend *fe, bool re_tune,
+                            unsigned int mode_flags, unsigned int *delay,
+                            enum fe_status *status)
+{
+    struct aml_dvb *dvb = container_of(fe->dvb, struct aml_dvb, adapter);
+    struct aml_fe_lock *fl = &dvb->fe_lock;
+    enum fe_status s = 0;
+    bool was_locked;
+    u64 ns;
+    int ret;
+
+    mutex_lock(&fl->demod);
+
+    if (re_tune) {
+        fl->tune_start = ktime_get();
+        fl->poll_ms = fe_lock_poll_min_ms;
+        fl->tunes++;
+
+        spin_lock(&fl->lock);
+        fl->status = 0;
+        fl->strength = fl->snr = 0;
+        fl->ber = fl->ucb = 0;
+        spin_unlock(&fl->lock);
+
+        // Cached PSI/SI belongs to the stream being left
+        aml_dmx_section_cache_flush(dvb);
+
+        // Demod setup, with an armed LNB switch laid around it
+        ret = aml_fe_sec_tune(&dvb->fe_sec, fe, !fl->tune);
+        if (ret)
+            goto out;
+    }
+
+    if (fl->tune)
+        ret = fl->tune(fe, re_tune, mode_flags, delay, &s);
+    else
+        ret = fl->read_status(fe, &s);
+    if (ret)
+        goto out;
+
+    fl->polls++;
+    was_locked = fl->status & FE_HAS_LOCK;
+
+    if (s & FE_HAS_LOCK) {
+        if (!was_locked) {
+            ns = ktime_to_ns(ktime_sub(ktime_get(), fl->tune_start));
+            fl->locks++;
+            fl->lock_ns = ns;
+            if (ns > fl->lock_max_ns)
+                fl->lock_max_ns = ns;
+            if (!dvb->bringup.first_lock_ns)
+                dvb->bringup.first_lock_ns = ktime_get_boottime_ns();
+        }
+
+        aml_fe_lock_sample(fe, fl);
+        *delay = msecs_to_jiffies(fe_stats_ms);
+    } else {
+        // Lost lock: search fast again; tables may change meanwhile
+        if (was_locked) {
+            fl->poll_ms = fe_lock_poll_min_ms;
+            aml_dmx_section_cache_flush(dvb);
+        }
+
+        *delay = max(msecs_to_jiffies(fl->poll_ms), 1UL);
+        fl->poll_ms = min(fl->poll_ms * 2, fe_lock_poll_max_ms);
+    }
+
+    spin_lock(&fl->lock);
+    fl->status = s;
+    spin_unlock(&fl->lock);
+
+    *status = s;
+out:
+    mutex_unlock(&fl->demod);
+    return ret;
+}
+
+static int aml_fe_lock_read_status(struct dvb_frontend *fe,
+                                   enum fe_status *status)
+{
+    struct aml_fe_lock *fl = aml_fe_lock_from_fe(fe);
+
+    spin_lock(&fl->lock);
+    *status = fl->status;
+    spin_unlock(&fl->lock);
+    return 0;
+}
+
+static int aml_fe_lock_read_signal_strength(struct dvb_frontend *fe,
+                                            u16 *strength)
+{
+    *strength = READ_ONCE(aml_fe_lock_from_fe(fe)->strength);
+    return 0;
+}
+
+static int aml_fe_lock_read_snr(struct dvb_frontend *fe, u16 *snr)
+{
+    *snr = READ_ONCE(aml_fe_lock_from_fe(fe)->snr);
+    return 0;
+}
+
+static int aml_fe_lock_read_ber(struct dvb_frontend *fe, u32 *ber)
+{
+    *ber = READ_ONCE(aml_fe_lock_from_fe(fe)->ber);
+    return 0;
+}
+
+static int aml_fe_lock_read_ucblocks(struct dvb_frontend *fe, u32 *ucb)
+{
+    *ucb = READ_ONCE(aml_fe_lock_from_fe(fe)->ucb);
+    return 0;
+}
+
+// First open and last close of the frontend device. A running blind
+// scan keeps the device from being opened.
+static int aml_fe_lock_bus_ctrl(struct dvb_frontend *fe, int acquire)
+{
+    struct aml_fe_lock *fl = aml_fe_lock_from_fe(fe);
+    int ret = 0;
+
+    spin_lock(&fl->lock);
+    if (acquire && fl->claimed) {
+        ret = -EBUSY;
+    } else {
+        fl->users = acquire;
+        if (acquire)
+            fl->thread = true;
+    }
+    spin_unlock(&fl->lock);
+    if (ret)
+        return ret;
+
+    if (fl->ts_bus_ctrl)
+        ret = fl->ts_bus_ctrl(fe, acquire);
+
+    if (ret && acquire) {
+        spin_lock(&fl->lock);
+        fl->users = false;
+        fl->thread = false;
+        spin_unlock(&fl->lock);
+        wake_up(&fl->wait);
+    }
+    return ret;
+}
+
+// The frontend thread's last demod access when it exits (also suspend)
+static int aml_fe_lock_sleep(struct dvb_frontend *fe)
+{
+    struct aml_fe_lock *fl = aml_fe_lock_from_fe(fe);
+    int ret = 0;
+
+    mutex_lock(&fl->demod);
+    if (fl->sleep)
+        ret = fl->sleep(fe);
+    mutex_unlock(&fl->demod);
+
+    spin_lock(&fl->lock);
+    if (!fl->users)
+        fl->thread = false;
+    spin_unlock(&fl->lock);
+    wake_up(&fl->wait);
+    return ret;
+}
+
+// Blind scan start: -EBUSY while the frontend device is open or another
+// scan has the demod
+int aml_fe_lock_claim(struct aml_fe_lock *fl)
+{
+    int ret = 0;
+
+    spin_lock(&fl->lock);
+    if (fl->users || fl->claimed)
+        ret = -EBUSY;
+    else
+        fl->claimed = true;
+    spin_unlock(&fl->lock);
+
+    return ret;
+}
+EXPORT_SYMBOL(aml_fe_lock_claim);
+
+static void aml_fe_lock_tuner_ctrl(struct dvb_frontend *fe,
+                                   int (*op)(struct dvb_frontend *fe))
+{
+    if (!op)
+        return;
+
+    if (fe->ops.i2c_gate_ctrl)
+        fe->ops.i2c_gate_ctrl(fe, 1);
+    op(fe);
+    if (fe->ops.i2c_gate_ctrl)
+        fe->ops.i2c_gate_ctrl(fe, 0);
+}
+
+/*
+ * Scan worker, after a successful claim: wait for the frontend thread to
+ * put the demod to sleep, then take it and wake it up the way the thread
+ * does on start. Without power-down on sleep the thread never calls
+ * sleep; once out of tune it no longer touches the demod, so the wait is
+ * bounded and the mutex covers the rest.
+ */
+void aml_fe_lock_take(struct aml_fe_lock *fl, struct dvb_frontend *fe)
+{
+    wait_event_timeout(fl->wait, !READ_ONCE(fl->thread),
+                       msecs_to_jiffies(AML_FE_LOCK_EXIT_MS));
+
+    mutex_lock(&fl->demod);
+    if (fe->ops.init)
+        fe->ops.init(fe);
+    aml_fe_lock_tuner_ctrl(fe, fe->ops.tuner_ops.init);
+}
+EXPORT_SYMBOL(aml_fe_lock_take);
+
+// Scan done: demod back to sleep, the frontend device may be opened again
+void aml_fe_lock_give(struct aml_fe_lock *fl, struct dvb_frontend *fe)
+{
+    aml_fe_lock_tuner_ctrl(fe, fe->ops.tuner_ops.sleep);
+    if (fl->sleep)
+        fl->sleep(fe);
+    mutex_unlock(&fl->demod);
+
+    spin_lock(&fl->lock);
+    fl->claimed = false;
+    spin_unlock(&fl->lock);
+}
+EXPORT_SYMBOL(aml_fe_lock_give);
+
+// Put the lock poll and the statistics cache in front of the driver
+void aml_fe_lock_hook(struct aml_fe_lock *fl, struct dvb_frontend *fe)
+{
+    struct dvb_frontend_ops *ops = &fe->ops;
+
+    spin_lock_init(&fl->lock);
+    mutex_init(&fl->demod);
+    init_waitqueue_head(&fl->wait);
+
+    // Frontend device and blind scan exclude each other
+    fl->ts_bus_ctrl = ops->ts_bus_ctrl;
+    fl->sleep = ops->sleep;
+    ops->ts_bus_ctrl = aml_fe_lock_bus_ctrl;
+    ops->sleep = aml_fe_lock_sleep;
+
+    // Drivers with their own search loop keep it
+    if (ops->get_frontend_algo &&
+        ops->get_frontend_algo(fe) == DVBFE_ALGO_CUSTOM)
+        return;
+
+    if (ops->get_frontend_algo &&
+        ops->get_frontend_algo(fe) == DVBFE_ALGO_HW)
+        fl->tune = ops->tune;
+
+    // Nothing to poll lock with
+    if (!fl->tune && !ops->read_status)
+        return;
+
+    fl->read_status = ops->read_status;
+    fl->read_signal_strength = ops->read_signal_strength;
+    fl->read_snr = ops->read_snr;
+    fl->read_ber = ops->read_ber;
+    fl->read_ucblocks = ops->read_ucblocks;
+
+    ops->get_frontend_algo = aml_fe_lock_algo;
+    ops->tune = aml_fe_lock_tune;
+    ops->read_status = aml_fe_lock_read_status;
+    if (ops->read_signal_strength)
+        ops->read_signal_strength = aml_fe_lock_read_signal_strength;
+    if (ops->read_snr)
+        ops->read_snr = aml_fe_lock_read_snr;
+    if (ops->read_ber)
+        ops->read_ber = aml_fe_lock_read_ber;
+    if (ops->read_ucblocks)
+        ops->read_ucblocks = aml_fe_lock_read_ucblocks;
+
+    fl->fe = fe;
+}
+EXPORT_SYMBOL(aml_fe_lock_hook);
+
+MODULE_DESCRIPTION("Amlogic DVB Frontend Lock Detection");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,710 @@
+// sources/aml_dvb/aml_dvb_fe_scan.c
+// Spectrum sweep and blind scan - /dev/aml-dvbN-scan
+//
+// A blind scan through the frontend device tries every frequency and
+// symbol rate in turn and waits out a lock timeout on each, minutes per
+// satellite and polarisation. Here the band is swept once for power:
+// only the tuner is stepped and its RF level read, the level falls back
+// to a full demod setup where the tuner has no get_rf_strength. Carriers
+// are found in that spectrum (noise floor, -3 dB edges, symbol rate from
+// the occupied width) and lock is only tried on them.
+//
+// AML_FE_SCAN_START runs the scan in the background. Spectrum points,
+// candidates, lock results and a summary are streamed on read() as
+// records (struct aml_fe_scan_event + payload) while the scan runs. The
+// scan has the frontend to itself: it fails with EBUSY while the frontend
+// device is open, the device cannot be opened until it is over, and the
+// demod is woken up for it and put back to sleep afterwards.
+//
+// With AML_FE_SCAN_EMULATE the same sweep, detection and lock sequence
+// runs against an emulated demod with a fixed set of carriers, with
+// tuner, AGC and lock times modelled; writing to the sysfs
+// frontend_scan attribute runs it and reports found vs. present.
+
+#include <linux/module.h>
+#include <linux/delay.h>
+#include <linux/fs.h>
+#include <linux/miscdevice.h>
+#include <linux/poll.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <media/dvb_frontend.h>
+#include <media/dvb_ringbuffer.h>
+#include "aml_dvb.h"
+
+#define AML_FE_SCAN_BUFSZ       (256 * 1024)
+#define AML_FE_SCAN_CHUNK       64      /* spectrum points per record */
+#define AML_FE_SCAN_MAX_POINTS  4096
+#define AML_FE_SCAN_MAX_CARRIERS 128
+
+// Satellite IF band (kHz) and sweep defaults
+#define AML_FE_SCAN_IF_MIN      950000
+#define AML_FE_SCAN_IF_MAX      2150000
+#define AML_FE_SCAN_STEP        1000
+#define AML_FE_SCAN_STEP_MAX    40000   /* keeps step * 100000 in a u32 */
+#define AML_FE_SCAN_THRESHOLD   300     /* centi-dB above the noise floor */
+#define AML_FE_SCAN_SR_MIN      1000000
+#define AML_FE_SCAN_SR_MAX      45000000
+
+// Tuner PLL and AGC settle per point, demod fallback per point
+#define AML_FE_SCAN_AGC_US      1000
+#define AML_FE_SCAN_DEMOD_US    3000
+
+#define AML_FE_SCAN_POLL_MS     10
+
+// Emulated demod: floor and noise in centi-dB, modelled step times
+#define AML_FE_EMU_FLOOR        -7500
+#define AML_FE_EMU_NOISE        60
+#define AML_FE_EMU_POINT_NS     (1500 * NSEC_PER_USEC)
+#define AML_FE_EMU_LOCK_NS      (60 * NSEC_PER_MSEC)
+
+static const struct {
+    u32 frequency;              /* kHz, IF */
+    u32 symbol_rate;
+    s32 level;                  /* centi-dB */
+} aml_fe_emu_carriers[] = {
+    {  987000, 27500000, -4500 }, { 1035000, 22000000, -5200 },
+    { 1094000, 30000000, -4800 }, { 1142000,  7200000, -5800 },
+    { 1168000,  2200000, -6100 }, { 1210000, 27500000, -4300 },
+    { 1265000, 29900000, -4700 }, { 1360000, 45000000, -5000 },
+    { 1447000,  3600000, -6300 }, { 1486000, 27500000, -4600 },
+    { 1544000, 22000000, -5400 }, { 1602000, 27500000, -4400 },
+    { 1675000, 12000000, -5600 }, { 1751000, 30000000, -4900 },
+    { 1838000, 27500000, -4500 }, { 1905000,  5000000, -6000 },
+    { 1962000, 27500000, -4700 }, { 2050000, 22000000, -5100 },
+};
+
+static long aml_fe_scan_put(struct aml_fe_scan *scan, u32 type,
+                            const void *data, u32 len)
+{
+    struct dvb_ringbuffer *rb = &scan->buffer;
+    struct aml_fe_scan_event ev = { .type = type, .len = len };
+
+    if (!scan->open)
+        return 0;
+
+    if (dvb_ringbuffer_free(rb) < sizeof(ev) + len) {
+        scan->dropped++;
+        return 0;
+    }
+
+    dvb_ringbuffer_write(rb, (u8 *)&ev, sizeof(ev));
+    dvb_ringbuffer_write(rb, data, len);
+    wake_up_interruptible(&rb->queue);
+    return 0;
+}
+
+// Emulated band: strongest carrier covering f, else the floor, plus noise
+static s32 aml_fe_emu_level(struct aml_fe_scan *scan, u32 f)
+{
+    s32 level = AML_FE_EMU_FLOOR;
+    u32 half;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(aml_fe_emu_carriers); i++) {
+        // Occupied width is symbol rate x (1 + 0.35 roll-off)
+        half = aml_fe_emu_carriers[i].symbol_rate / 1000 * 135 / 200;
+        if (f + half >= aml_fe_emu_carriers[i].frequency &&
+            f <= aml_fe_emu_carriers[i].frequency + half)
+            level = max(level, aml_fe_emu_carriers[i].level);
+    }
+
+    scan->seed = scan->seed * 1103515245 + 12345;
+    return level + (s32)((scan->seed >> 16) % (2 * AML_FE_EMU_NOISE + 1)) -
+           AML_FE_EMU_NOISE;
+}
+
+// Emulated lock: the demod pulls in within a quarter symbol rate and
+// searches +-20% around the given symbol rate
+static bool aml_fe_emu_lock(struct aml_fe_scan *scan,
+                            struct aml_fe_scan_carrier *cr, u32 timeout_ms)
+{
+    u32 df, tol;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(aml_fe_emu_carriers); i++) {
+        df = abs((s32)cr->frequency - (s32)aml_fe_emu_carriers[i].frequency);
+        tol = aml_fe_emu_carriers[i].symbol_rate / 4000;
+        if (df > tol)
+            continue;
+        if (abs((s32)(cr->symbol_rate - aml_fe_emu_carriers[i].symbol_rate)) >
+            aml_fe_emu_carriers[i].symbol_rate / 5)
+            continue;
+
+        scan->model_ns += AML_FE_EMU_LOCK_NS;
+        cr->frequency = aml_fe_emu_carriers[i].frequency;
+        cr->symbol_rate = aml_fe_emu_carriers[i].symbol_rate;
+        cr->delsys = SYS_DVBS2;
+        cr->status = FE_HAS_SIGNAL | FE_HAS_CARRIER | FE_HAS_VITERBI |
+                     FE_HAS_SYNC | FE_HAS_LOCK;
+        return true;
+    }
+
+    scan->model_ns += (u64)timeout_ms * NSEC_PER_MSEC;
+    return false;
+}
+
+// Driver read_status/strength, behind the lock poll cache when hooked
+static int aml_fe_scan_read_status(struct aml_dvb *dvb, struct dvb_frontend *fe,
+                                   enum fe_status *status)
+{
+    struct aml_fe_lock *fl = &dvb->fe_lock;
+
+    if (fl->fe)
+        return fl->read_status ? fl->read_status(fe, status) : -EOPNOTSUPP;
+
+    return fe->ops.read_status ? fe->ops.read_status(fe, status) : -EOPNOTSUPP;
+}
+
+static int aml_fe_scan_read_strength(struct aml_dvb *dvb,
+                                     struct dvb_frontend *fe, u16 *strength)
+{
+    struct aml_fe_lock *fl = &dvb->fe_lock;
+    int (*rd)(struct dvb_frontend *fe, u16 *strength);
+
+    rd = fl->fe ? fl->read_signal_strength : fe->ops.read_signal_strength;
+    return rd ? rd(fe, strength) : -EOPNOTSUPP;
+}
+
+// RF level at f over one step of bandwidth, in centi-dB
+static int aml_fe_scan_level(struct aml_fe_scan *scan, u32 f, s32 *level)
+{
+    struct aml_dvb *dvb = scan->dvb;
+    struct dvb_frontend *fe = dvb->frontend;
+    struct dtv_frontend_properties *c;
+    struct dvb_tuner_ops *t;
+    u16 strength = 0;
+    int ret;
+
+    if (scan->emu) {
+        scan->model_ns += AML_FE_EMU_POINT_NS;
+        *level = aml_fe_emu_level(scan, f);
+        return 0;
+    }
+
+    c = &fe->dtv_property_cache;
+    t = &fe->ops.tuner_ops;
+    c->delivery_system = SYS_DVBS;
+    c->frequency = f;
+    c->symbol_rate = scan->req.step * 1000 * 100 / 135;
+
+    if (t->set_params && t->get_rf_strength) {
+        ret = t->set_params(fe);
+        if (ret)
+            return ret;
+        fsleep(AML_FE_SCAN_AGC_US);
+        ret = t->get_rf_strength(fe, &strength);
+    } else {
+        ret = fe->ops.set_frontend ? fe->ops.set_frontend(fe) : -EOPNOTSUPP;
+        if (ret)
+            return ret;
+        fsleep(AML_FE_SCAN_DEMOD_US);
+        ret = aml_fe_scan_read_strength(dvb, fe, &strength);
+    }
+
+    // Montage strength is AGC derived and close to linear in dB
+    *level = (s32)strength * 10000 / 65535 - 10000;
+    return ret;
+}
+
+static int aml_fe_scan_try_lock(struct aml_fe_scan *scan,
+                                struct aml_fe_scan_carrier *cr)
+{
+    struct aml_dvb *dvb = scan->dvb;
+    struct dvb_frontend *fe;
+    struct dtv_frontend_properties *c;
+    enum fe_status s = 0;
+    unsigned long end;
+    u32 timeout_ms;
+    int ret;
+
+    // Acquisition time grows with the symbol period
+    timeout_ms = 150 + 400000 / max(cr->symbol_rate / 1000, 1U);
+
+    if (scan->emu) {
+        aml_fe_emu_lock(scan, cr, timeout_ms);
+        return 0;
+    }
+
+    fe = dvb->frontend;
+    c = &fe->dtv_property_cache;
+    c->delivery_system = SYS_DVBS2;
+    c->frequency = cr->frequency;
+    c->symbol_rate = cr->symbol_rate;
+    c->modulation = QPSK;
+    c->fec_inner = FEC_AUTO;
+    c->rolloff = ROLLOFF_AUTO;
+    c->inversion = INVERSION_AUTO;
+    c->pilot = PILOT_AUTO;
+    c->stream_id = NO_STREAM_ID_FILTER;
+
+    if (!fe->ops.set_frontend)
+        return -EOPNOTSUPP;
+    ret = fe->ops.set_frontend(fe);
+    if (ret)
+        return ret;
+
+    end = jiffies + msecs_to_jiffies(timeout_ms);
+    do {
+        msleep(AML_FE_SCAN_POLL_MS);
+        ret = aml_fe_scan_read_status(dvb, fe, &s);
+        if (ret)
+            return ret;
+    } while (!(s & FE_HAS_LOCK) && time_before(jiffies, end) &&
+             !READ_ONCE(scan->abort));
+
+    cr->status = s;
+    if (!(s & FE_HAS_LOCK))
+        return 0;
+
+    // What the demod actually found
+    if (fe->ops.get_frontend)
+        fe->ops.get_frontend(fe, c);
+    cr->frequency = c->frequency;
+    cr->symbol_rate = c->symbol_rate;
+    cr->delsys = c->delivery_system;
+    cr->modulation = c->modulation;
+    cr->fec = c->fec_inner;
+    cr->rolloff = c->rolloff;
+    return 0;
+}
+
+static int aml_fe_scan_cmp(const void *a, const void *b)
+{
+    s32 x = *(const s32 *)a, y = *(const s32 *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+// Noise floor: 20th percentile of the sweep
+static s32 aml_fe_scan_floor(const struct aml_fe_scan_point *pts,
+                             unsigned int n)
+{
+    s32 *lv, floor;
+    unsigned int i;
+
+    lv = kvmalloc_array(n, sizeof(*lv), GFP_KERNEL);
+    if (!lv)
+        return pts[0].level;
+
+    for (i = 0; i < n; i++)
+        lv[i] = pts[i].level;
+    sort(lv, n, sizeof(*lv), aml_fe_scan_cmp, NULL);
+    floor = lv[n / 5];
+    kvfree(lv);
+    return floor;
+}
+
+/*
+ * Carriers: runs of points above floor + threshold. The -3 dB edges
+ * around the run's peak give the occupied width, the symbol rate is
+ * that width over 1.35 (the widest common roll-off).
+ */
+static unsigned int aml_fe_scan_detect(struct aml_fe_scan *scan,
+                                       struct aml_fe_scan_point *pts,
+                                       unsigned int n,
+                                       struct aml_fe_scan_carrier *out)
+{
+    const struct aml_fe_scan_req *req = &scan->req;
+    unsigned int i, j, k, lo, hi, found = 0;
+    s32 floor, peak, prev, cur, next;
+    u32 width, sr;
+
+    if (n < 3)
+        return 0;
+
+    // Three-point median against AGC noise, keeps the carrier edges
+    prev = pts[0].level;
+    for (i = 1; i + 1 < n; i++) {
+        cur = pts[i].level;
+        next = pts[i + 1].level;
+        pts[i].level = max(min(prev, cur), min(max(prev, cur), next));
+        prev = cur;
+    }
+
+    floor = aml_fe_scan_floor(pts, n);
+
+    for (i = 0; i < n && found < AML_FE_SCAN_MAX_CARRIERS; i = j) {
+        if (pts[i].level < floor + req->threshold) {
+            j = i + 1;
+            continue;
+        }
+
+        peak = pts[i].level;
+        for (j = i; j < n && pts[j].level >= floor + req->threshold; j++)
+            peak = max(peak, pts[j].level);
+
+        lo = j;
+        hi = i;
+        for (k = i; k < j; k++) {
+            if (pts[k].level >= peak - 300) {
+                lo = min(lo, k);
+                hi = k;
+            }
+        }
+
+        width = pts[hi].frequency - pts[lo].frequency + req->step;
+        sr = width * 1000 / 135 * 100;
+
+        // Edges are only known to a step; let the widest through
+        if (sr < req->min_sr || sr > req->max_sr + req->max_sr / 10)
+            continue;
+        sr = min(sr, req->max_sr);
+
+        out[found].frequency = (pts[lo].frequency + pts[hi].frequency) / 2;
+        out[found].symbol_rate = sr;
+        out[found].level = peak;
+        out[found].status = 0;
+        out[found].delsys = 0;
+        out[found].modulation = 0;
+        out[found].fec = 0;
+        out[found].rolloff = 0;
+        found++;
+    }
+
+    return found;
+}
+
+static void aml_fe_scan_run(struct aml_fe_scan *scan)
+{
+    const struct aml_fe_scan_req *req = &scan->req;
+    struct aml_fe_scan_point *pts;
+    struct aml_fe_scan_carrier *cr;
+    struct aml_fe_scan_done done = {};
+    unsigned int n, i, c = 0, ncr;
+    ktime_t start = ktime_get();
+    int ret = 0;
+
+    n = (req->end - req->start) / req->step + 1;
+    pts = kvmalloc_array(n, sizeof(*pts), GFP_KERNEL);
+    cr = kcalloc(AML_FE_SCAN_MAX_CARRIERS, sizeof(*cr), GFP_KERNEL);
+    if (!pts || !cr) {
+        ret = -ENOMEM;
+        goto out;
+    }
+
+    scan->model_ns = 0;
+    scan->seed = 0x5eed;
+
+    // Sweep, streaming the spectrum as it comes in
+    for (i = 0; i < n && !READ_ONCE(scan->abort); i++) {
+        pts[i].frequency = req->start + i * req->step;
+        ret = aml_fe_scan_level(scan, pts[i].frequency, &pts[i].level);
+        if (ret)
+            goto out;
+
+        if (++c == AML_FE_SCAN_CHUNK || i + 1 == n) {
+            aml_fe_scan_put(scan, AML_FE_SCAN_SPECTRUM, &pts[i + 1 - c],
+                            c * sizeof(*pts));
+            c = 0;
+        }
+    }
+    n = i;
+    scan->points = n;
+    done.points = n;
+    done.sweep_ms = div_u64(scan->emu ? scan->model_ns :
+                            ktime_to_ns(ktime_sub(ktime_get(), start)),
+                            NSEC_PER_MSEC);
+
+    ncr = aml_fe_scan_detect(scan, pts, n, cr);
+    scan->candidates = ncr;
+    done.candidates = ncr;
+    for (i = 0; i < ncr; i++)
+        aml_fe_scan_put(scan, AML_FE_SCAN_CANDIDATE, &cr[i], sizeof(cr[i]));
+
+    // Lock only where there is something
+    for (i = 0; i < ncr && !READ_ONCE(scan->abort); i++) {
+        ret = aml_fe_scan_try_lock(scan, &cr[i]);
+        if (ret)
+            goto out;
+        if (cr[i].status & FE_HAS_LOCK)
+            done.locked++;
+        aml_fe_scan_put(scan, AML_FE_SCAN_RESULT, &cr[i], sizeof(cr[i]));
+    }
+    scan->locked = done.locked;
+
+out:
+    done.error = ret;
+    done.aborted = READ_ONCE(scan->abort);
+    done.total_ms = div_u64(scan->emu ? scan->model_ns :
+                            ktime_to_ns(ktime_sub(ktime_get(), start)),
+                            NSEC_PER_MSEC);
+    scan->sweep_ms = done.sweep_ms;
+    scan->total_ms = done.total_ms;
+    aml_fe_scan_put(scan, AML_FE_SCAN_DONE, &done, sizeof(done));
+
+    kfree(cr);
+    kvfree(pts);
+}
+
+static void aml_fe_scan_work(struct work_struct *work)
+{
+    struct aml_fe_scan *scan = container_of(work, struct aml_fe_scan, work);
+    struct aml_dvb *dvb = scan->dvb;
+
+    if (!scan->emu)
+        aml_fe_lock_take(&dvb->fe_lock, dvb->frontend);
+
+    aml_fe_scan_run(scan);
+
+    if (!scan->emu)
+        aml_fe_lock_give(&dvb->fe_lock, dvb->frontend);
+    WRITE_ONCE(scan->running, false);
+}
+
+// Stop a running scan and wait for it; scan->mutex held
+static void aml_fe_scan_stop(struct aml_fe_scan *scan)
+{
+    WRITE_ONCE(scan->abort, true);
+    flush_work(&scan->work);
+}
+
+static int aml_fe_scan_start(struct aml_fe_scan *scan,
+                             const struct aml_fe_scan_req *req)
+{
+    struct aml_fe_scan_req r = *req;
+    int ret;
+
+    if (r.flags & ~AML_FE_SCAN_EMULATE)
+        return -EINVAL;
+    if (!(r.flags & AML_FE_SCAN_EMULATE) && !scan->dvb->frontend)
+        return -ENODEV;
+
+    r.start = r.start ?: AML_FE_SCAN_IF_MIN;
+    r.end = r.end ?: AML_FE_SCAN_IF_MAX;
+    r.step = r.step ?: AML_FE_SCAN_STEP;
+    r.threshold = r.threshold ?: AML_FE_SCAN_THRESHOLD;
+    r.min_sr = r.min_sr ?: AML_FE_SCAN_SR_MIN;
+    r.max_sr = r.max_sr ?: AML_FE_SCAN_SR_MAX;
+
+    if (r.start >= r.end || r.threshold < 0 || r.min_sr > r.max_sr ||
+        r.step > AML_FE_SCAN_STEP_MAX ||
+        (r.end - r.start) / r.step >= AML_FE_SCAN_MAX_POINTS)
+        return -EINVAL;
+
+    if (READ_ONCE(scan->running))
+        return -EBUSY;
+
+    // The frontend is ours for the whole scan
+    if (!(r.flags & AML_FE_SCAN_EMULATE)) {
+        ret = aml_fe_lock_claim(&scan->dvb->fe_lock);
+        if (ret)
+            return ret;
+    }
+
+    scan->req = r;
+    scan->emu = r.flags & AML_FE_SCAN_EMULATE;
+    scan->abort = false;
+    scan->running = true;
+    scan->points = scan->candidates = scan->locked = 0;
+    queue_work(system_unbound_wq, &scan->work);
+    return 0;
+}
+
+static long aml_fe_scan_ioctl(struct file *file, unsigned int cmd,
+                              unsigned long arg)
+{
+    struct aml_fe_scan *scan = container_of(file->private_data,
+                                            struct aml_fe_scan, misc);
+    struct aml_fe_scan_req req;
+    long ret;
+
+    switch (cmd) {
+    case AML_FE_SCAN_START:
+        if (copy_from_user(&req, (void __user *)arg, sizeof(req)))
+            return -EFAULT;
+
+        mutex_lock(&scan->mutex);
+        ret = aml_fe_scan_start(scan, &req);
+        mutex_unlock(&scan->mutex);
+        return ret;
+
+    case AML_FE_SCAN_STOP:
+        mutex_lock(&scan->mutex);
+        aml_fe_scan_stop(scan);
+        mutex_unlock(&scan->mutex);
+        return 0;
+    }
+
+    return -ENOTTY;
+}
+
+// Whole records only; at least one record must fit in @count
+static ssize_t aml_fe_scan_read(struct file *file, char __user *buf,
+                                size_t count, loff_t *ppos)
+{
+    struct aml_fe_scan *scan = container_of(file->private_data,
+                                            struct aml_fe_scan, misc);
+    struct dvb_ringbuffer *rb = &scan->buffer;
+    struct aml_fe_scan_event ev;
+    size_t done = 0, need = sizeof(ev), rec;
+    bool too_big = false;
+    int i, ret;
+
+again:
+    ret = wait_event_interruptible(rb->queue,
+                                   (file->f_flags & O_NONBLOCK) ||
+                                   dvb_ringbuffer_avail(rb) >= need);
+    if (ret)
+        return ret;
+
+    while (dvb_ringbuffer_avail(rb) >= sizeof(ev)) {
+        for (i = 0; i < sizeof(ev); i++)
+            ((u8 *)&ev)[i] = DVB_RINGBUFFER_PEEK(rb, i);
+
+        rec = sizeof(ev) + ev.len;
+        if (done + rec > count) {
+            too_big = true;
+            break;
+        }
+
+        // aml_fe_scan_put() may still be writing the payload
+        if (dvb_ringbuffer_avail(rb) < rec) {
+            need = rec;
+            break;
+        }
+
+        if (dvb_ringbuffer_read_user(rb, buf + done, rec) != rec) {
+            ret = -EFAULT;
+            break;
+        }
+        done += rec;
+    }
+
+    if (done)
+        return done;
+    if (ret)
+        return ret;
+    if (too_big)
+        return -EINVAL;     /* next record does not fit */
+    if (file->f_flags & O_NONBLOCK)
+        return -EWOULDBLOCK;
+    goto again;             /* record still being queued */
+}
+
+static __poll_t aml_fe_scan_poll(struct file *file, poll_table *wait)
+{
+    struct aml_fe_scan *scan = container_of(file->private_data,
+                                            struct aml_fe_scan, misc);
+
+    poll_wait(file, &scan->buffer.queue, wait);
+
+    return dvb_ringbuffer_empty(&scan->buffer) ? 0 : EPOLLIN | EPOLLRDNORM;
+}
+
+// One reader at a time: the scan and its record stream are per adapter
+static int aml_fe_scan_open(struct inode *inode, struct file *file)
+{
+    struct aml_fe_scan *scan = container_of(file->private_data,
+                                            struct aml_fe_scan, misc);
+    void *mem;
+    int ret = 0;
+
+    mem = vmalloc(AML_FE_SCAN_BUFSZ);
+    if (!mem)
+        return -ENOMEM;
+
+    mutex_lock(&scan->mutex);
+    if (scan->open || READ_ONCE(scan->running)) {
+        ret = -EBUSY;
+    } else {
+        dvb_ringbuffer_init(&scan->buffer, mem, AML_FE_SCAN_BUFSZ);
+        scan->dropped = 0;
+        scan->open = true;
+        mem = NULL;
+    }
+    mutex_unlock(&scan->mutex);
+
+    vfree(mem);
+    return ret ? ret : nonseekable_open(inode, file);
+}
+
+static int aml_fe_scan_release(struct inode *inode, struct file *file)
+{
+    struct aml_fe_scan *scan = container_of(file->private_data,
+                                            struct aml_fe_scan, misc);
+
+    mutex_lock(&scan->mutex);
+    aml_fe_scan_stop(scan);
+    scan->open = false;
+    vfree(scan->buffer.data);
+    scan->buffer.data = NULL;
+    mutex_unlock(&scan->mutex);
+    return 0;
+}
+
+static const struct file_operations aml_fe_scan_fops = {
+    .owner = THIS_MODULE,
+    .open = aml_fe_scan_open,
+    .release = aml_fe_scan_release,
+    .read = aml_fe_scan_read,
+    .poll = aml_fe_scan_poll,
+    .unlocked_ioctl = aml_fe_scan_ioctl,
+    .compat_ioctl = compat_ptr_ioctl,
+    .llseek = noop_llseek,
+};
+
+// Emulated scan from sysfs: sweep the whole IF band, wait for the result
+int aml_fe_scan_bench(struct aml_dvb *dvb, u32 step)
+{
+    struct aml_fe_scan *scan = &dvb->fe_scan;
+    struct aml_fe_scan_req req = {
+        .step = step,
+        .flags = AML_FE_SCAN_EMULATE,
+    };
+    int ret;
+
+    mutex_lock(&scan->mutex);
+    ret = aml_fe_scan_start(scan, &req);
+    if (!ret)
+        flush_work(&scan->work);
+    scan->expected = ARRAY_SIZE(aml_fe_emu_carriers);
+    mutex_unlock(&scan->mutex);
+    return ret;
+}
+EXPORT_SYMBOL(aml_fe_scan_bench);
+
+int aml_fe_scan_init(struct aml_dvb *dvb)
+{
+    struct aml_fe_scan *scan = &dvb->fe_scan;
+    int ret;
+
+    scan->dvb = dvb;
+    mutex_init(&scan->mutex);
+    INIT_WORK(&scan->work, aml_fe_scan_work);
+    init_waitqueue_head(&scan->buffer.queue);
+
+    snprintf(scan->name, sizeof(scan->name), "aml-dvb%d-scan",
+             dvb->adapter.num);
+    scan->misc.minor = MISC_DYNAMIC_MINOR;
+    scan->misc.name = scan->name;
+    scan->misc.fops = &aml_fe_scan_fops;
+    scan->misc.parent = dvb->dev;
+
+    ret = misc_register(&scan->misc);
+    scan->node = !ret;
+    return ret;
+}
+EXPORT_SYMBOL(aml_fe_scan_init);
+
+void aml_fe_scan_exit(struct aml_dvb *dvb)
+{
+    struct aml_fe_scan *scan = &dvb->fe_scan;
+
+    if (!scan->dvb)
+        return;
+
+    if (scan->node)
+        misc_deregister(&scan->misc);
+    scan->node = false;
+    mutex_lock(&scan->mutex);
+    aml_fe_scan_stop(scan);
+    mutex_unlock(&scan->mutex);
+    scan->dvb = NULL;
+}
+EXPORT_SYMBOL(aml_fe_scan_exit);
+
+MODULE_DESCRIPTION("Amlogic DVB Spectrum and Blind Scan");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,454 @@
+// sources/aml_dvb/aml_dvb_fe_sec.c
+// LNB voltage, 22 kHz tone and DiSEqC switching in the tune sequence
+//
+// A satellite or band change is usually FE_SET_TONE(off), FE_SET_VOLTAGE,
+// FE_DISEQC_SEND_MASTER_CMD, FE_DISEQC_SEND_BURST, FE_SET_TONE and then
+// the tune, with generous sleeps in user space between each. Here the
+// whole switch is armed with one AML_FE_SEC_SWITCH on /dev/aml-dvbN-sec
+// and carried out by the frontend thread on the next DTV_TUNE:
+//
+//  - the voltage is changed first and the demod is set up for the new
+//    transponder right away, while the voltage settles; the tone and
+//    the commands follow once the bus is quiet
+//  - bus events are spaced by the DiSEqC minimum of 15 ms and no more
+//  - an unchanged voltage or tone, and a command the switch already got
+//    since the LNB was powered, are not sent again
+//
+// The plain FE_SET_* ioctls go through the same state, so they skip
+// redundant steps and keep the minimum spacing as well. The lnb-supply
+// regulator powers the LNB and follows SEC_VOLTAGE_OFF.
+
+#include <linux/module.h>
+#include <linux/delay.h>
+#include <linux/fs.h>
+#include <linux/miscdevice.h>
+#include <linux/regulator/consumer.h>
+#include <linux/uaccess.h>
+#include <media/dvb_frontend.h>
+#include "aml_dvb.h"
+
+// DiSEqC bus spec 4.2: quiet time around voltage, tone and messages
+#define AML_SEC_SETTLE_MS   15
+
+// LNB supply ramp plus LNB start-up when powered from off
+#define AML_SEC_POWER_ON_MS 100
+
+static struct aml_fe_sec *aml_fe_sec_from_fe(struct dvb_frontend *fe)
+{
+    struct aml_dvb *dvb = container_of(fe->dvb, struct aml_dvb, adapter);
+
+    return &dvb->fe_sec;
+}
+
+// The next bus event may go no earlier than ms from now
+static void aml_fe_sec_settle(struct aml_fe_sec *sec, unsigned int ms)
+{
+    ktime_t t = ktime_add_ms(ktime_get(), ms);
+
+    if (ktime_after(t, sec->ready))
+        sec->ready = t;
+}
+
+static void aml_fe_sec_wait(struct aml_fe_sec *sec)
+{
+    s64 us = ktime_us_delta(sec->ready, ktime_get());
+
+    if (us > 0)
+        fsleep(us);
+}
+
+// State forgotten: the chip was reset or the LNB lost power
+static void aml_fe_sec_forget(struct aml_fe_sec *sec)
+{
+    sec->voltage = -1;
+    sec->tone = -1;
+    sec->msg_len = 0;
+    sec->burst = AML_FE_SEC_NO_BURST;
+    sec->cmd_valid = false;
+}
+
+static int aml_fe_sec_apply_voltage(struct aml_fe_sec *sec,
+                                    struct dvb_frontend *fe,
+                                    enum fe_sec_voltage voltage)
+{
+    unsigned int settle = AML_SEC_SETTLE_MS;
+    int ret = 0;
+
+    if (voltage == sec->voltage) {
+        sec->skipped++;
+        return 0;
+    }
+
+    if (voltage != SEC_VOLTAGE_OFF && !sec->lnb_on) {
+        if (sec->lnb) {
+            ret = regulator_enable(sec->lnb);
+            if (ret)
+                return ret;
+        }
+        sec->lnb_on = true;
+        settle = AML_SEC_POWER_ON_MS;
+    }
+
+    if (sec->set_voltage)
+        ret = sec->set_voltage(fe, voltage);
+    if (ret) {
+        sec->voltage = -1;
+        return ret;
+    }
+
+    if (voltage == SEC_VOLTAGE_OFF) {
+        if (sec->lnb_on && sec->lnb)
+            regulator_disable(sec->lnb);
+        sec->lnb_on = false;
+        aml_fe_sec_forget(sec);
+    }
+
+    sec->voltage = voltage;
+    aml_fe_sec_settle(sec, settle);
+    return 0;
+}
+
+static int aml_fe_sec_apply_tone(struct aml_fe_sec *sec,
+                                 struct dvb_frontend *fe,
+                                 enum fe_sec_tone_mode tone)
+{
+    int ret;
+
+    if (tone == sec->tone) {
+        sec->skipped++;
+        return 0;
+    }
+    if (!sec->set_tone)
+        return -EOPNOTSUPP;
+
+    aml_fe_sec_wait(sec);
+    ret = sec->set_tone(fe, tone);
+    sec->tone = ret ? -1 : tone;
+    aml_fe_sec_settle(sec, AML_SEC_SETTLE_MS);
+    return ret;
+}
+
+static int aml_fe_sec_apply_msg(struct aml_fe_sec *sec,
+                                struct dvb_frontend *fe,
+                                struct dvb_diseqc_master_cmd *cmd)
+{
+    int ret;
+
+    if (!sec->diseqc_send_master_cmd)
+        return -EOPNOTSUPP;
+
+    aml_fe_sec_wait(sec);
+    ret = sec->diseqc_send_master_cmd(fe, cmd);
+    aml_fe_sec_settle(sec, AML_SEC_SETTLE_MS);
+    return ret;
+}
+
+static int aml_fe_sec_apply_burst(struct aml_fe_sec *sec,
+                                  struct dvb_frontend *fe,
+                                  enum fe_sec_mini_cmd burst)
+{
+    int ret;
+
+    if (!sec->diseqc_send_burst)
+        return -EOPNOTSUPP;
+
+    aml_fe_sec_wait(sec);
+    ret = sec->diseqc_send_burst(fe, burst);
+    aml_fe_sec_settle(sec, AML_SEC_SETTLE_MS);
+    return ret;
+}
+
+// Switch commands already delivered since the LNB was powered
+static bool aml_fe_sec_cmd_known(struct aml_fe_sec *sec,
+                                 const struct aml_fe_sec_switch *sw)
+{
+    return sec->cmd_valid && sw->msg_len == sec->msg_len &&
+           !memcmp(sw->msg, sec->msg, sw->msg_len) &&
+           sw->burst == sec->burst;
+}
+
+static int aml_fe_sec_setup(struct dvb_frontend *fe, bool setup)
+{
+    if (!setup || !fe->ops.set_frontend)
+        return 0;
+
+    return fe->ops.set_frontend(fe);
+}
+
+/*
+ * From the frontend thread on a (re)tune. With a switch armed, the demod
+ * is set up straight after the voltage change, inside its settle time,
+ * and the tone and DiSEqC steps follow; setup = false when the driver
+ * sets the demod up in its own tune(), which then follows this.
+ */
+int aml_fe_sec_tune(struct aml_fe_sec *sec, struct dvb_frontend *fe,
+                    bool setup)
+{
+    struct aml_fe_sec_switch sw;
+    struct dvb_diseqc_master_cmd cmd;
+    bool cmds;
+    ktime_t start;
+    u64 ns;
+    int ret;
+
+    if (!sec->fe)
+        return aml_fe_sec_setup(fe, setup);
+
+    mutex_lock(&sec->mutex);
+    if (!sec->pending) {
+        mutex_unlock(&sec->mutex);
+        return aml_fe_sec_setup(fe, setup);
+    }
+    sw = sec->next;
+    sec->pending = false;
+    start = ktime_get();
+
+    cmds = sw.msg_len || sw.burst != AML_FE_SEC_NO_BURST;
+    if (cmds && !(sw.flags & AML_FE_SEC_FORCE) &&
+        aml_fe_sec_cmd_known(sec, &sw)) {
+        cmds = false;
+        sec->skipped++;
+    }
+
+    // Voltage first, then demod and tuner setup while the LNB settles;
+    // the bus steps below wait out whatever of the settle time is left
+    ret = aml_fe_sec_apply_voltage(sec, fe, sw.voltage);
+    if (ret)
+        goto out;
+
+    ret = aml_fe_sec_setup(fe, setup);
+    if (ret)
+        goto out;
+
+    // Commands need the tone off; without them the tone is final now
+    ret = aml_fe_sec_apply_tone(sec, fe, cmds ? SEC_TONE_OFF : sw.tone);
+    if (ret || !cmds)
+        goto out;
+
+    if (sw.msg_len) {
+        memcpy(cmd.msg, sw.msg, sw.msg_len);
+        cmd.msg_len = sw.msg_len;
+        ret = aml_fe_sec_apply_msg(sec, fe, &cmd);
+        if (ret)
+            goto out;
+    }
+
+    if (sw.burst != AML_FE_SEC_NO_BURST) {
+        ret = aml_fe_sec_apply_burst(sec, fe, sw.burst);
+        if (ret)
+            goto out;
+    }
+
+    memcpy(sec->msg, sw.msg, sw.msg_len);
+    sec->msg_len = sw.msg_len;
+    sec->burst = sw.burst;
+    sec->cmd_valid = true;
+
+    ret = aml_fe_sec_apply_tone(sec, fe, sw.tone);
+
+out:
+    if (ret) {
+        aml_fe_sec_forget(sec);
+    } else {
+        ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+        sec->switches++;
+        sec->switch_ns = ns;
+        if (ns > sec->switch_max_ns)
+            sec->switch_max_ns = ns;
+    }
+    mutex_unlock(&sec->mutex);
+    return ret;
+}
+EXPORT_SYMBOL(aml_fe_sec_tune);
+
+// FE_SET_VOLTAGE and friends: same state, same spacing
+static int aml_fe_sec_set_voltage(struct dvb_frontend *fe,
+                                  enum fe_sec_voltage voltage)
+{
+    struct aml_fe_sec *sec = aml_fe_sec_from_fe(fe);
+    int ret;
+
+    mutex_lock(&sec->mutex);
+    ret = aml_fe_sec_apply_voltage(sec, fe, voltage);
+    mutex_unlock(&sec->mutex);
+    return ret;
+}
+
+static int aml_fe_sec_set_tone(struct dvb_frontend *fe,
+                               enum fe_sec_tone_mode tone)
+{
+    struct aml_fe_sec *sec = aml_fe_sec_from_fe(fe);
+    int ret;
+
+    mutex_lock(&sec->mutex);
+    ret = aml_fe_sec_apply_tone(sec, fe, tone);
+    mutex_unlock(&sec->mutex);
+    return ret;
+}
+
+// Commands from user space are always sent; motors act on repeats
+static int aml_fe_sec_send_master_cmd(struct dvb_frontend *fe,
+                                      struct dvb_diseqc_master_cmd *cmd)
+{
+    struct aml_fe_sec *sec = aml_fe_sec_from_fe(fe);
+    int ret;
+
+    mutex_lock(&sec->mutex);
+    ret = aml_fe_sec_apply_msg(sec, fe, cmd);
+    sec->cmd_valid = false;
+    mutex_unlock(&sec->mutex);
+    return ret;
+}
+
+static int aml_fe_sec_send_burst(struct dvb_frontend *fe,
+                                 enum fe_sec_mini_cmd burst)
+{
+    struct aml_fe_sec *sec = aml_fe_sec_from_fe(fe);
+    int ret;
+
+    mutex_lock(&sec->mutex);
+    ret = aml_fe_sec_apply_burst(sec, fe, burst);
+    sec->cmd_valid = false;
+    mutex_unlock(&sec->mutex);
+    return ret;
+}
+
+static int aml_fe_sec_init_fe(struct dvb_frontend *fe)
+{
+    struct aml_fe_sec *sec = aml_fe_sec_from_fe(fe);
+
+    mutex_lock(&sec->mutex);
+    aml_fe_sec_forget(sec);
+    mutex_unlock(&sec->mutex);
+
+    return sec->init ? sec->init(fe) : 0;
+}
+
+static int aml_fe_sec_check(const struct aml_fe_sec_switch *sw)
+{
+    if (sw->voltage != SEC_VOLTAGE_13 && sw->voltage != SEC_VOLTAGE_18 &&
+        sw->voltage != SEC_VOLTAGE_OFF)
+        return -EINVAL;
+    if (sw->tone != SEC_TONE_ON && sw->tone != SEC_TONE_OFF)
+        return -EINVAL;
+    if (sw->msg_len && (sw->msg_len < 3 || sw->msg_len > sizeof(sw->msg)))
+        return -EINVAL;
+    if (sw->burst != SEC_MINI_A && sw->burst != SEC_MINI_B &&
+        sw->burst != AML_FE_SEC_NO_BURST)
+        return -EINVAL;
+    if (sw->flags & ~AML_FE_SEC_FORCE)
+        return -EINVAL;
+
+    return 0;
+}
+
+static long aml_fe_sec_ioctl(struct file *file, unsigned int cmd,
+                             unsigned long arg)
+{
+    struct aml_fe_sec *sec = container_of(file->private_data,
+                                          struct aml_fe_sec, misc);
+    struct aml_fe_sec_switch sw;
+    int ret;
+
+    if (cmd != AML_FE_SEC_SWITCH)
+        return -ENOTTY;
+
+    if (copy_from_user(&sw, (void __user *)arg, sizeof(sw)))
+        return -EFAULT;
+
+    ret = aml_fe_sec_check(&sw);
+    if (ret)
+        return ret;
+
+    // Replaces a switch that no tune has picked up yet
+    mutex_lock(&sec->mutex);
+    sec->next = sw;
+    sec->pending = true;
+    mutex_unlock(&sec->mutex);
+    return 0;
+}
+
+static const struct file_operations aml_fe_sec_fops = {
+    .owner = THIS_MODULE,
+    .open = nonseekable_open,
+    .unlocked_ioctl = aml_fe_sec_ioctl,
+    .compat_ioctl = compat_ptr_ioctl,
+    .llseek = noop_llseek,
+};
+
+// Put the SEC state in front of the driver and add the switch node
+int aml_fe_sec_init(struct aml_dvb *dvb, struct dvb_frontend *fe)
+{
+    struct aml_fe_sec *sec = &dvb->fe_sec;
+    struct dvb_frontend_ops *ops = &fe->ops;
+    int ret;
+
+    // Terrestrial and cable frontends have nothing to switch
+    if (!ops->set_voltage && !ops->set_tone && !ops->diseqc_send_master_cmd)
+        return 0;
+
+    sec->lnb = devm_regulator_get_optional(dvb->dev, "lnb");
+    if (IS_ERR(sec->lnb)) {
+        if (PTR_ERR(sec->lnb) != -ENODEV)
+            return PTR_ERR(sec->lnb);
+        sec->lnb = NULL;
+    }
+
+    mutex_init(&sec->mutex);
+    aml_fe_sec_forget(sec);
+    sec->lnb_on = false;
+    sec->pending = false;
+
+    sec->init = ops->init;
+    sec->set_voltage = ops->set_voltage;
+    sec->set_tone = ops->set_tone;
+    sec->diseqc_send_master_cmd = ops->diseqc_send_master_cmd;
+    sec->diseqc_send_burst = ops->diseqc_send_burst;
+
+    ops->init = aml_fe_sec_init_fe;
+    ops->set_voltage = aml_fe_sec_set_voltage;
+    if (ops->set_tone)
+        ops->set_tone = aml_fe_sec_set_tone;
+    if (ops->diseqc_send_master_cmd)
+        ops->diseqc_send_master_cmd = aml_fe_sec_send_master_cmd;
+    if (ops->diseqc_send_burst)
+        ops->diseqc_send_burst = aml_fe_sec_send_burst;
+
+    snprintf(sec->name, sizeof(sec->name), "aml-dvb%d-sec",
+             dvb->adapter.num);
+    sec->misc.minor = MISC_DYNAMIC_MINOR;
+    sec->misc.name = sec->name;
+    sec->misc.fops = &aml_fe_sec_fops;
+    sec->misc.parent = dvb->dev;
+
+    ret = misc_register(&sec->misc);
+    if (ret)
+        dvb_warn(dvb, "LNB switch node unavailable: %d\n", ret);
+    sec->node = !ret;
+
+    sec->fe = fe;
+    return 0;
+}
+EXPORT_SYMBOL(aml_fe_sec_init);
+
+void aml_fe_sec_exit(struct aml_dvb *dvb)
+{
+    struct aml_fe_sec *sec = &dvb->fe_sec;
+
+    if (!sec->fe)
+        return;
+
+    if (sec->node)
+        misc_deregister(&sec->misc);
+    sec->node = false;
+
+    // LNB power off with the frontend gone
+    if (sec->lnb_on && sec->lnb)
+        regulator_disable(sec->lnb);
+    sec->lnb_on = false;
+    sec->fe = NULL;
+}
+EXPORT_SYMBOL(aml_fe_sec_exit);
+
+MODULE_DESCRIPTION("Amlogic DVB LNB and DiSEqC Switching");
+MODULE_LICENSE("GPL");
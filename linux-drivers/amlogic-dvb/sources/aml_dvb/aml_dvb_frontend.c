@@ -1,18 +1,71 @@
 // sources/aml_dvb/aml_dvb_frontend.c
 // DVB Frontend attachment (M88RS6060)
+//
+// The I2C bus is looked up in probe, which defers until it exists.
+// The demod is attached and registered from the deferred bring-up, as
+// it is probed over I2C; unregistered and detached on remove. The
+// driver and its header come from the M88RS6060 tree patches/002
+// applies to.
 
+#include <linux/of.h>
+#include <linux/i2c.h>
 #include <media/dvb_frontend.h>
+#include "m88rs6060.h"
 #include "aml_dvb.h"
 
+static void aml_dvb_put_frontend_bus(void *data)
+{
+    struct aml_dvb *dvb = data;
+
+    i2c_put_adapter(dvb->fe_bus);
+    dvb->fe_bus = NULL;
+}
+
+// Probe time: no demod in the device tree is fine, a missing bus defers
+int aml_dvb_find_frontend_bus(struct aml_dvb *dvb)
+{
+    struct device_node *np, *bus_np;
+    struct i2c_adapter *i2c;
+
+    np = of_find_compatible_node(NULL, NULL, "montage,m88rs6060");
+    if (!np)
+        return 0;
+
+    dvb->fe_addr = 0x69;
+    of_property_read_u32(np, "reg", &dvb->fe_addr);
+    bus_np = of_get_parent(np);
+    of_node_put(np);
+    i2c = of_find_i2c_adapter_by_node(bus_np);
+    of_node_put(bus_np);
+    if (!i2c)
+        return dev_err_probe(&dvb->pdev->dev, -EPROBE_DEFER,
+                             "Waiting for the frontend I2C bus\n");
+
+    dvb->fe_bus = i2c;
+    return devm_add_action_or_reset(&dvb->pdev->dev,
+                                    aml_dvb_put_frontend_bus, dvb);
+}
+EXPORT_SYMBOL(aml_dvb_find_frontend_bus);
+
 int aml_dvb_attach_frontend(struct aml_dvb *dvb)
 {
     struct dvb_frontend *fe;
-    void *frontend_priv;
+    int ret;
+
+    if (!dvb->fe_bus)
+        return -ENODEV;
+
+    // The demod talks to the AO bus through the register cache
+    ret = aml_fe_i2c_init(&dvb->fe_i2c, &dvb->pdev->dev, dvb->fe_bus,
+                          dvb->fe_addr, "fe");
+    if (ret)
+        return ret;
 
     // M88RS6060 is already in mainline
-    fe = dvb_attach(m88rs6060_attach, &m88rs6060_config);
+    fe = dvb_attach(m88rs6060_attach, &m88rs6060_config, &dvb->fe_i2c.adap);
     if (!fe) {
         dev_err(&dvb->pdev->dev, "Failed to attach M88RS6060\n");
+        aml_fe_i2c_exit(&dvb->fe_i2c);
         return -ENODEV;
     }
 
@@ -20,7 +73,42 @@ int aml_dvb_attach_frontend(struct aml_dvb *dvb)
         dev_info(&dvb->pdev->dev, "Simple tuner attached\n");
     }
 
-    dvb->fe = fe;
+    aml_fe_i2c_hook(&dvb->fe_i2c, fe);
+    aml_fe_lock_hook(&dvb->fe_lock, fe);
+
+    // LNB switching, pipelined with the tune
+    ret = aml_fe_sec_init(dvb, fe);
+    if (ret)
+        goto err_detach;
+
+    ret = dvb_register_frontend(&dvb->adapter, fe);
+    if (ret) {
+        dev_err(&dvb->pdev->dev, "Failed to register frontend: %d\n", ret);
+        aml_fe_sec_exit(dvb);
+        goto err_detach;
+    }
+
+    dvb->frontend = fe;
     return 0;
+
+err_detach:
+    dvb->fe_lock.fe = NULL;
+    dvb_frontend_detach(fe);
+    aml_fe_i2c_exit(&dvb->fe_i2c);
+    return ret;
 }
 EXPORT_SYMBOL(aml_dvb_attach_frontend);
+
+void aml_dvb_detach_frontend(struct aml_dvb *dvb)
+{
+    if (!dvb->frontend)
+        return;
+
+    dvb_unregister_frontend(dvb->frontend);
+    aml_fe_sec_exit(dvb);
+    dvb->fe_lock.fe = NULL;
+    dvb_frontend_detach(dvb->frontend);
+    dvb->frontend = NULL;
+    aml_fe_i2c_exit(&dvb->fe_i2c);
+}
+EXPORT_SYMBOL(aml_dvb_detach_frontend);
@@ -0,0 +1,240 @@
+// sources/aml_dvb/aml_dvb_pidset.c
+// PID set - double-buffered hardware PID table for fast channel zapping
+//
+// The next PID table is built off to the side in pid_next, written into
+// the inactive hardware bank and made live with a single bank flip, so
+// the old and new services never coexist in the filter.
+
+#include <linux/module.h>
+#include <linux/string.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
+#include "aml_dvb.h"
+
+static unsigned int pid_commit_delay_ms = 20;
+module_param(pid_commit_delay_ms, uint, 0644);
+MODULE_PARM_DESC(pid_commit_delay_ms,
+                 "Delay before a feed stop is committed to hardware (ms)");
+
+void aml_pid_set_clear(struct aml_pid_set *set)
+{
+    int i;
+
+    for (i = 0; i < AML_DVB_MAX_PIDS; i++)
+        set->pid[i] = AML_PID_NONE;
+}
+EXPORT_SYMBOL(aml_pid_set_clear);
+
+// Write pid_next into the inactive bank and flip. Called with pid_lock held.
+static int aml_dvb_pidset_flush(struct aml_dvb *dvb)
+{
+    int bank = !dvb->pid_live;
+    struct aml_pid_set *shadow = &dvb->pid_bank[bank];
+    ktime_t start;
+    u64 ns;
+    int i, ret;
+
+    // Clocks gated (runtime suspend): resume commits it
+    if (!dvb->hw_ready) {
+        dvb->pid_dirty = true;
+        return 0;
+    }
+
+    dvb->pid_dirty = false;
+
+    if (!memcmp(&dvb->pid_next, &dvb->pid_bank[dvb->pid_live],
+                sizeof(dvb->pid_next)))
+        return 0;
+
+    start = ktime_get();
+
+    // Only slots that differ from what the inactive bank already holds
+    for (i = 0; i < dvb->variant->pid_slots; i++) {
+        if (shadow->pid[i] == dvb->pid_next.pid[i])
+            continue;
+
+        ret = aml_dvb_reg_write_pid_bank(dvb, bank, i, dvb->pid_next.pid[i]);
+        if (ret)
+            return ret;
+        shadow->pid[i] = dvb->pid_next.pid[i];
+    }
+
+    aml_dvb_reg_select_pid_bank(dvb, bank);
+    dvb->pid_live = bank;
+
+    ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+    dvb->pid_commits++;
+    dvb->pid_commit_ns = ns;
+    if (ns > dvb->pid_commit_max_ns)
+        dvb->pid_commit_max_ns = ns;
+
+    dvb_dbg(dvb, "PID set committed to bank %d in %llu ns\n", bank, ns);
+    return 0;
+}
+
+static void aml_dvb_pidset_work(struct work_struct *work)
+{
+    struct aml_dvb *dvb = container_of(to_delayed_work(work),
+                                       struct aml_dvb, pid_work);
+
+    mutex_lock(&dvb->pid_lock);
+    if (dvb->pid_dirty && !dvb->pid_hold)
+        aml_dvb_pidset_flush(dvb);
+    mutex_unlock(&dvb->pid_lock);
+}
+
+int aml_dvb_pidset_init(struct aml_dvb *dvb)
+{
+    int bank;
+
+    mutex_init(&dvb->pid_lock);
+    INIT_DELAYED_WORK(&dvb->pid_work, aml_dvb_pidset_work);
+
+    aml_pid_set_clear(&dvb->pid_next);
+    for (bank = 0; bank < 2; bank++)
+        aml_pid_set_clear(&dvb->pid_bank[bank]);
+
+    dvb->pid_live = 0;
+    return 0;
+}
+EXPORT_SYMBOL(aml_dvb_pidset_init);
+
+// Load both bank shadows into the hardware once the clock is running,
+// at bring-up and on runtime resume, then commit anything queued while
+// the registers were gated. Marks the table live for later flushes.
+void aml_dvb_pidset_hw_init(struct aml_dvb *dvb)
+{
+    int bank, i;
+
+    mutex_lock(&dvb->pid_lock);
+    for (bank = 0; bank < 2; bank++)
+        for (i = 0; i < dvb->variant->pid_slots; i++)
+            aml_dvb_reg_write_pid_bank(dvb, bank, i,
+                                       dvb->pid_bank[bank].pid[i]);
+
+    aml_dvb_reg_select_pid_bank(dvb, dvb->pid_live);
+    aml_dvb_reg_set_pid_all(dvb, dvb->pid_all > 0);
+
+    WRITE_ONCE(dvb->hw_ready, true);
+    if (dvb->pid_dirty && !dvb->pid_hold)
+        aml_dvb_pidset_flush(dvb);
+    mutex_unlock(&dvb->pid_lock);
+}
+EXPORT_SYMBOL(aml_dvb_pidset_hw_init);
+
+// Runtime suspend: stop touching the banks, keep editing the shadows
+void aml_dvb_pidset_hw_exit(struct aml_dvb *dvb)
+{
+    mutex_lock(&dvb->pid_lock);
+    WRITE_ONCE(dvb->hw_ready, false);
+    mutex_unlock(&dvb->pid_lock);
+}
+EXPORT_SYMBOL(aml_dvb_pidset_hw_exit);
+
+void aml_dvb_pidset_exit(struct aml_dvb *dvb)
+{
+    cancel_delayed_work_sync(&dvb->pid_work);
+}
+EXPORT_SYMBOL(aml_dvb_pidset_exit);
+
+// Start a transaction on the next PID table. The caller edits the
+// returned set and finishes with aml_dvb_pidset_commit().
+struct aml_pid_set *aml_dvb_pidset_begin(struct aml_dvb *dvb)
+{
+    mutex_lock(&dvb->pid_lock);
+    return &dvb->pid_next;
+}
+EXPORT_SYMBOL(aml_dvb_pidset_begin);
+
+int aml_dvb_pidset_commit(struct aml_dvb *dvb)
+{
+    int ret;
+
+    ret = aml_dvb_pidset_flush(dvb);
+    mutex_unlock(&dvb->pid_lock);
+
+    return ret;
+}
+EXPORT_SYMBOL(aml_dvb_pidset_commit);
+
+// Feed start commits immediately so the first packets are not delayed;
+// any stops still pending from the same zap go out in the same flip.
+int aml_dvb_pidset_feed_start(struct aml_dvb *dvb, int index, u16 pid)
+{
+    struct aml_pid_set *set;
+
+    if (index < 0 || index >= dvb->variant->pid_slots)
+        return -EINVAL;
+
+    // Full-TS feeds (PID 0x2000) have no slot in the table
+    if ((pid & ~AML_PID_SEC_CRC) > 0x1FFF)
+        return 0;
+
+    set = aml_dvb_pidset_begin(dvb);
+    set->pid[index] = pid;
+
+    // Inside a hold the whole batch goes out in aml_dvb_pidset_release()
+    if (dvb->pid_hold) {
+        dvb->pid_dirty = true;
+        mutex_unlock(&dvb->pid_lock);
+        return 0;
+    }
+
+    return aml_dvb_pidset_commit(dvb);
+}
+EXPORT_SYMBOL(aml_dvb_pidset_feed_start);
+
+// Hold back feed start commits, e.g. while a filter batch is installed
+void aml_dvb_pidset_hold(struct aml_dvb *dvb)
+{
+    mutex_lock(&dvb->pid_lock);
+    dvb->pid_hold++;
+    mutex_unlock(&dvb->pid_lock);
+}
+EXPORT_SYMBOL(aml_dvb_pidset_hold);
+
+// Drop a hold; the last one commits everything queued in a single flip
+int aml_dvb_pidset_release(struct aml_dvb *dvb)
+{
+    int ret = 0;
+
+    mutex_lock(&dvb->pid_lock);
+    if (!--dvb->pid_hold && dvb->pid_dirty)
+        ret = aml_dvb_pidset_flush(dvb);
+    mutex_unlock(&dvb->pid_lock);
+
+    return ret;
+}
+EXPORT_SYMBOL(aml_dvb_pidset_release);
+
+// Feed stop is deferred: dvb-core already drops packets for stopped
+// feeds, and a following start picks the removal up in its commit.
+void aml_dvb_pidset_feed_stop(struct aml_dvb *dvb, int index)
+{
+    if (index < 0 || index >= dvb->variant->pid_slots)
+        return;
+
+    mutex_lock(&dvb->pid_lock);
+    dvb->pid_next.pid[index] = AML_PID_NONE;
+    dvb->pid_dirty = true;
+    mutex_unlock(&dvb->pid_lock);
+
+    mod_delayed_work(system_wq, &dvb->pid_work,
+                     msecs_to_jiffies(pid_commit_delay_ms));
+}
+EXPORT_SYMBOL(aml_dvb_pidset_feed_stop);
+
+// Full-TS users (0x2000 feeds, fan-out readers) have no slot in the
+// table; while any of them is active the filter passes every PID.
+void aml_dvb_pidset_pass_all(struct aml_dvb *dvb, bool on)
+{
+    mutex_lock(&dvb->pid_lock);
+    dvb->pid_all += on ? 1 : -1;
+    if (dvb->hw_ready)
+        aml_dvb_reg_set_pid_all(dvb, dvb->pid_all > 0);
+    mutex_unlock(&dvb->pid_lock);
+}
+EXPORT_SYMBOL(aml_dvb_pidset_pass_all);
+
+MODULE_DESCRIPTION("Amlogic DVB PID Set");
+MODULE_LICENSE("GPL");
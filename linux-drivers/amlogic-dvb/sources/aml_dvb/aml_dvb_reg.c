@@ -5,6 +5,9 @@
  */
 
 #include <linux/io.h>
+#include <linux/bitfield.h>
+#include <linux/bitmap.h>
+#include <linux/slab.h>
 #include "aml_dvb.h"
 
 /* GXL (S905D/S905X) Hardware Register Map */
@@ -28,17 +31,34 @@
 #define TS_DMA_BUFF_SIZE        0x2c
 #define TS_DMA_START_ADDR       0x30
 #define TS_DMA_END_ADDR         0x34
+#define TS_DMA_TIMEOUT          0x38    /* us without DMA-done, 0 = off */
+#define TS_DMA_INT_COALESCE     0x3c    /* min us between DMA-done irqs */
 
 /* Interrupt registers */
 #define TS_INT_CONTROL          0x40
 #define TS_INT_STATUS           0x44
 #define TS_INT_MASK             0x48
 
-/* PID filter registers */
-#define TS_PID_FILTER_BASE      0x100
-#define TS_PID_FILTER_SIZE      256
+/* Section CRC engine */
+#define TS_SEC_CRC_CONTROL      0x50
+#define TS_SEC_CRC_FIFO         0x54
+
+/*
+ * PID filter table: variant->pid_slots entries from variant->pid_base.
+ * Two banks back to back, selected by TS_TOP_CONFIG_PID_BANK.
+ */
+#define TS_PID_FILTER_BANK(v, n)    ((v)->pid_base + (n) * (v)->pid_slots * 4)
+
+/*
+ * Hardware demux channels 1..N: each has its own copy of the DMA,
+ * interrupt and PID filter block at the variant's stride. Channel 0 is
+ * the block above. All channels see the same TS input.
+ */
+#define TS_CHAN_REG(v, ch, reg)     ((ch) * (v)->chan_stride + (reg))
 
 /* Register bit definitions */
+#define TS_INT_CONTROL_ENABLE           BIT(0)
+
 
 /* TS_TOP_CONFIG bits */
 #define TS_TOP_CONFIG_ENABLE            BIT(0)
@@ -49,6 +69,8 @@
 #define TS_TOP_CONFIG_VALID_POL         BIT(5)
 #define TS_TOP_CONFIG_BIT_ENDIAN        BIT(6)
 #define TS_TOP_CONFIG_BYTE_ENDIAN       BIT(7)
+#define TS_TOP_CONFIG_PID_BANK          BIT(8)
+#define TS_TOP_CONFIG_PID_ALL           BIT(9)  /* bypass the PID filter */
 
 /* TS_DMA_CONTROL bits */
 #define TS_DMA_CONTROL_ENABLE           BIT(0)
@@ -56,6 +78,16 @@
 #define TS_DMA_CONTROL_IRQ_ENABLE       BIT(2)
 #define TS_DMA_CONTROL_SG_MODE          BIT(3)
 
+/* TS_SEC_CRC_CONTROL bits */
+#define TS_SEC_CRC_ENABLE               BIT(0)
+#define TS_SEC_CRC_FIFO_RESET           BIT(1)
+
+/* TS_SEC_CRC_FIFO entry: one per completed section on a CRC-flagged PID */
+#define TS_SEC_CRC_FIFO_VALID           BIT(31)
+#define TS_SEC_CRC_FIFO_FAIL            BIT(30)
+#define TS_SEC_CRC_FIFO_TAG             GENMASK(29, 14) /* CRC_32 field, low 16 bits */
+#define TS_SEC_CRC_FIFO_PID             GENMASK(12, 0)
+
 /* TS_INT_STATUS bits */
 #define TS_INT_STATUS_DMA_DONE          BIT(0)
 #define TS_INT_STATUS_OVERFLOW          BIT(1)
@@ -133,7 +165,7 @@ int aml_dvb_reg_init(struct aml_dvb *dvb)
 /* PID filter management */
 int aml_dvb_reg_add_pid(struct aml_dvb *dvb, u16 pid, int index)
 {
-    if (index >= TS_PID_FILTER_SIZE) {
+    if (index >= dvb->variant->pid_slots) {
         dvb_err(dvb, "PID index out of range: %d\n", index);
         return -EINVAL;
     }
@@ -149,7 +181,7 @@ int aml_dvb_reg_add_pid(struct aml_dvb *dvb, u16 pid, int index)
 
 int aml_dvb_reg_remove_pid(struct aml_dvb *dvb, int index)
 {
-    if (index >= TS_PID_FILTER_SIZE) {
+    if (index >= dvb->variant->pid_slots) {
         dvb_err(dvb, "PID index out of range: %d\n", index);
         return -EINVAL;
     }
@@ -163,6 +195,83 @@ int aml_dvb_reg_remove_pid(struct aml_dvb *dvb, int index)
     return 0;
 }
 
+/* PID table banks */
+int aml_dvb_reg_write_pid_bank(struct aml_dvb *dvb, int bank, int index, u16 pid)
+{
+    if (index >= dvb->variant->pid_slots) {
+        dvb_err(dvb, "PID index out of range: %d\n", index);
+        return -EINVAL;
+    }
+    
+    aml_dvb_reg_write(dvb, TS_PID_FILTER_BANK(dvb->variant, bank) + index * 4,
+                      pid & (0x1FFF | AML_PID_SEC_CRC));
+    
+    return 0;
+}
+
+void aml_dvb_reg_select_pid_bank(struct aml_dvb *dvb, int bank)
+{
+    /* Hardware latches the bank select on the next packet boundary */
+    if (bank)
+        aml_dvb_reg_set_bits(dvb, TS_TOP_CONFIG, TS_TOP_CONFIG_PID_BANK);
+    else
+        aml_dvb_reg_clear_bits(dvb, TS_TOP_CONFIG, TS_TOP_CONFIG_PID_BANK);
+    
+    dvb_dbg(dvb, "PID bank %d active\n", bank);
+}
+
+/* Full-TS capture: pass every PID, whatever the banks hold */
+void aml_dvb_reg_set_pid_all(struct aml_dvb *dvb, bool on)
+{
+    if (on)
+        aml_dvb_reg_set_bits(dvb, TS_TOP_CONFIG, TS_TOP_CONFIG_PID_ALL);
+    else
+        aml_dvb_reg_clear_bits(dvb, TS_TOP_CONFIG, TS_TOP_CONFIG_PID_ALL);
+}
+
+/* TS input format: serial/parallel and clock polarity, applied live */
+void aml_dvb_reg_set_ts_input(struct aml_dvb *dvb, int mode, int clk_pol)
+{
+    u32 config = aml_dvb_reg_read(dvb, TS_TOP_CONFIG);
+    
+    config &= ~(TS_TOP_CONFIG_SERIAL | TS_TOP_CONFIG_PARALLEL |
+                TS_TOP_CONFIG_CLK_POL);
+    config |= TS_TOP_CONFIG_ENABLE;
+    config |= mode == TS_MODE_PARALLEL ? TS_TOP_CONFIG_PARALLEL :
+                                         TS_TOP_CONFIG_SERIAL;
+    if (clk_pol)
+        config |= TS_TOP_CONFIG_CLK_POL;
+    
+    aml_dvb_reg_write(dvb, TS_TOP_CONFIG, config);
+}
+
+/* Section CRC engine */
+void aml_dvb_reg_sec_crc_enable(struct aml_dvb *dvb, bool enable)
+{
+    aml_dvb_reg_write(dvb, TS_SEC_CRC_CONTROL, TS_SEC_CRC_FIFO_RESET);
+    aml_dvb_reg_write(dvb, TS_SEC_CRC_CONTROL, enable ? TS_SEC_CRC_ENABLE : 0);
+}
+
+/*
+ * Pop one verdict from the CRC FIFO.
+ * Returns -ENODATA when empty, else 0 with the PID, the section's tag
+ * (low half of its CRC_32 field as received) and pass/fail filled in.
+ */
+int aml_dvb_reg_sec_crc_pop(struct aml_dvb *dvb, u16 *pid, u16 *tag,
+                            bool *fail)
+{
+    u32 val = aml_dvb_reg_read(dvb, TS_SEC_CRC_FIFO);
+    
+    if (!(val & TS_SEC_CRC_FIFO_VALID))
+        return -ENODATA;
+    
+    *pid = FIELD_GET(TS_SEC_CRC_FIFO_PID, val);
+    *tag = FIELD_GET(TS_SEC_CRC_FIFO_TAG, val);
+    *fail = !!(val & TS_SEC_CRC_FIFO_FAIL);
+    
+    return 0;
+}
+
 /* DMA configuration */
 int aml_dvb_reg_setup_dma(struct aml_dvb *dvb, dma_addr_t addr, size_t size)
 {
@@ -180,6 +289,53 @@ int aml_dvb_reg_setup_dma(struct aml_dvb *dvb, dma_addr_t addr, size_t size)
     return 0;
 }
 
+/* Ring pointers as offsets from the start of the DMA buffer */
+size_t aml_dvb_reg_dma_wr_offset(struct aml_dvb *dvb)
+{
+    return aml_dvb_reg_read(dvb, TS_DMA_WR_PTR) - (u32)dvb->dma_addr;
+}
+
+void aml_dvb_reg_dma_set_rd_offset(struct aml_dvb *dvb, size_t offset)
+{
+    aml_dvb_reg_write(dvb, TS_DMA_RD_PTR, (u32)dvb->dma_addr + offset);
+}
+
+/* Raise TS_INT_STATUS_TIMEOUT when data sits in the ring for @us */
+void aml_dvb_reg_set_dma_timeout(struct aml_dvb *dvb, u32 us)
+{
+    aml_dvb_reg_write(dvb, TS_DMA_TIMEOUT, us);
+    
+    if (us)
+        aml_dvb_reg_set_bits(dvb, TS_INT_MASK, TS_INT_STATUS_TIMEOUT);
+    else
+        aml_dvb_reg_clear_bits(dvb, TS_INT_MASK, TS_INT_STATUS_TIMEOUT);
+}
+
+/* Hold DMA-done interrupts back for at least @us after the last one */
+void aml_dvb_reg_set_irq_coalesce(struct aml_dvb *dvb, u32 us)
+{
+    aml_dvb_reg_write(dvb, TS_DMA_INT_COALESCE, us);
+}
+
+/* Interrupt status, limited to enabled sources (AML_DVB_IRQ_* layout) */
+u32 aml_dvb_reg_irq_status(struct aml_dvb *dvb)
+{
+    return aml_dvb_reg_read(dvb, TS_INT_STATUS) &
+           aml_dvb_reg_read(dvb, TS_INT_MASK);
+}
+
+void aml_dvb_reg_irq_ack(struct aml_dvb *dvb, u32 status)
+{
+    /* Write 1 to clear */
+    aml_dvb_reg_write(dvb, TS_INT_STATUS, status);
+}
+
+/* Interrupt output of the whole block (all channels) */
+void aml_dvb_reg_irq_enable(struct aml_dvb *dvb, bool enable)
+{
+    aml_dvb_reg_write(dvb, TS_INT_CONTROL, enable ? TS_INT_CONTROL_ENABLE : 0);
+}
+
 void aml_dvb_reg_start_dma(struct aml_dvb *dvb)
 {
     u32 control = TS_DMA_CONTROL_ENABLE | TS_DMA_CONTROL_IRQ_ENABLE;
@@ -199,6 +355,139 @@ void aml_dvb_reg_stop_dma(struct aml_dvb *dvb)
     dvb_dbg(dvb, "DMA stopped\n");
 }
 
+/* Secondary demux channels: single-bank PID table and own DMA ring */
+int aml_dvb_reg_chan_write_pid(struct aml_dvb *dvb, int ch, int index, u16 pid)
+{
+    const struct aml_dvb_variant *v = dvb->variant;
+    
+    if (index >= v->pid_slots) {
+        dvb_err(dvb, "PID index out of range: %d\n", index);
+        return -EINVAL;
+    }
+    
+    aml_dvb_reg_write(dvb, TS_CHAN_REG(v, ch, TS_PID_FILTER_BANK(v, 0)) +
+                      index * 4, pid & 0x1FFF);
+    
+    return 0;
+}
+
+void aml_dvb_reg_chan_start_dma(struct aml_dvb *dvb, int ch,
+                                dma_addr_t addr, size_t size)
+{
+    const struct aml_dvb_variant *v = dvb->variant;
+    
+    aml_dvb_reg_write(dvb, TS_CHAN_REG(v, ch, TS_DMA_START_ADDR), addr);
+    aml_dvb_reg_write(dvb, TS_CHAN_REG(v, ch, TS_DMA_END_ADDR), addr + size);
+    aml_dvb_reg_write(dvb, TS_CHAN_REG(v, ch, TS_DMA_BUFF_SIZE), size);
+    aml_dvb_reg_write(dvb, TS_CHAN_REG(v, ch, TS_DMA_WR_PTR), addr);
+    aml_dvb_reg_write(dvb, TS_CHAN_REG(v, ch, TS_DMA_RD_PTR), addr);
+    
+    aml_dvb_reg_write(dvb, TS_CHAN_REG(v, ch, TS_INT_STATUS), 0xFFFFFFFF);
+    aml_dvb_reg_write(dvb, TS_CHAN_REG(v, ch, TS_INT_MASK),
+                      TS_INT_STATUS_DMA_DONE | TS_INT_STATUS_OVERFLOW);
+    aml_dvb_reg_write(dvb, TS_CHAN_REG(v, ch, TS_DMA_CONTROL),
+                      TS_DMA_CONTROL_ENABLE | TS_DMA_CONTROL_IRQ_ENABLE);
+    
+    dvb_dbg(dvb, "Demux channel %d DMA started\n", ch);
+}
+
+void aml_dvb_reg_chan_stop_dma(struct aml_dvb *dvb, int ch)
+{
+    const struct aml_dvb_variant *v = dvb->variant;
+    
+    aml_dvb_reg_write(dvb, TS_CHAN_REG(v, ch, TS_DMA_CONTROL), 0);
+    aml_dvb_reg_write(dvb, TS_CHAN_REG(v, ch, TS_INT_MASK), 0);
+}
+
+/* Ring pointers as absolute bus addresses */
+u32 aml_dvb_reg_chan_dma_wr(struct aml_dvb *dvb, int ch)
+{
+    return aml_dvb_reg_read(dvb, TS_CHAN_REG(dvb->variant, ch, TS_DMA_WR_PTR));
+}
+
+void aml_dvb_reg_chan_dma_set_rd(struct aml_dvb *dvb, int ch, u32 addr)
+{
+    aml_dvb_reg_write(dvb, TS_CHAN_REG(dvb->variant, ch, TS_DMA_RD_PTR), addr);
+}
+
+/* Read and acknowledge a channel's pending interrupts */
+u32 aml_dvb_reg_chan_irq(struct aml_dvb *dvb, int ch)
+{
+    const struct aml_dvb_variant *v = dvb->variant;
+    u32 status = aml_dvb_reg_read(dvb, TS_CHAN_REG(v, ch, TS_INT_STATUS)) &
+                 aml_dvb_reg_read(dvb, TS_CHAN_REG(v, ch, TS_INT_MASK));
+    
+    if (status)
+        aml_dvb_reg_write(dvb, TS_CHAN_REG(v, ch, TS_INT_STATUS), status);
+    
+    return status;
+}
+
+/* Registers every channel block has, for the layout check */
+static const u32 aml_dvb_reg_chan_regs[] = {
+    TS_TOP_CONFIG, TS_TOP_STATUS, TS_FILE_CONFIG,
+    TS_PL_PID_INDEX, TS_PL_PID_DATA, TS_PL_CHAN_PTR, TS_PL_STATUS,
+    TS_DMA_CONTROL, TS_DMA_WR_PTR, TS_DMA_RD_PTR, TS_DMA_BUFF_SIZE,
+    TS_DMA_START_ADDR, TS_DMA_END_ADDR, TS_DMA_TIMEOUT, TS_DMA_INT_COALESCE,
+    TS_INT_CONTROL, TS_INT_STATUS, TS_INT_MASK,
+    TS_SEC_CRC_CONTROL, TS_SEC_CRC_FIFO,
+};
+
+static int aml_dvb_reg_layout_claim(unsigned long *used, unsigned int words,
+                                    u32 reg, u32 *at)
+{
+    *at = reg;
+
+    if (reg / 4 >= words)
+        return -ERANGE;
+    if (__test_and_set_bit(reg / 4, used))
+        return -EADDRINUSE;
+
+    return 0;
+}
+
+/*
+ * Lay out every register the driver touches for @v (control registers
+ * and PID banks of each channel) in a model of the register block.
+ * Fails with -ERANGE if one is outside the block, -EADDRINUSE if two
+ * land on the same word; @at gets the offset.
+ */
+int aml_dvb_reg_layout_check(const struct aml_dvb_variant *v, u32 *at)
+{
+    unsigned int words = v->reg_size / 4;
+    unsigned long *used;
+    int ch, bank, i, ret = 0;
+
+    *at = 0;
+    if (v->pid_slots <= AML_DVB_SERVICE_PIDS ||
+        v->pid_slots > AML_DVB_MAX_PIDS || !v->demux_cores ||
+        v->demux_cores > AML_DVB_MAX_DEMUX)
+        return -EINVAL;
+
+    used = bitmap_zalloc(words, GFP_KERNEL);
+    if (!used)
+        return -ENOMEM;
+
+    for (ch = 0; ch < v->demux_cores && !ret; ch++) {
+        u32 blk = TS_CHAN_REG(v, ch, 0);
+
+        for (i = 0; i < ARRAY_SIZE(aml_dvb_reg_chan_regs) && !ret; i++)
+            ret = aml_dvb_reg_layout_claim(used, words,
+                                           blk + aml_dvb_reg_chan_regs[i], at);
+
+        // Channel 0 has both banks, the others a single table
+        for (bank = 0; bank < (ch ? 1 : 2) && !ret; bank++)
+            for (i = 0; i < v->pid_slots && !ret; i++)
+                ret = aml_dvb_reg_layout_claim(used, words,
+                                               blk + TS_PID_FILTER_BANK(v, bank) +
+                                               i * 4, at);
+    }
+
+    bitmap_free(used);
+    return ret;
+}
+EXPORT_SYMBOL(aml_dvb_reg_layout_check);
+
 /* Status reporting */
 void aml_dvb_reg_dump(struct aml_dvb *dvb)
 {
@@ -0,0 +1,335 @@
+// sources/aml_dvb/aml_dvb_service.c
+// Service filter - program all PIDs of one program number from PAT/PMT
+//
+// The driver watches PAT for the program's PMT PID, then PMT for its
+// PCR/video/audio/subtitle PIDs, and keeps the reserved service slots
+// of the PID table in sync, including across PMT version changes.
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include "aml_dvb.h"
+
+#define PAT_PID             0x0000
+#define PAT_TABLE_ID        0x00
+#define PMT_TABLE_ID        0x02
+
+static bool aml_dvb_service_es_wanted(u8 stream_type, const u8 *desc, int len)
+{
+    switch (stream_type) {
+    case 0x01: case 0x02: case 0x10: case 0x1B: case 0x24: case 0x42:
+        return true;    /* video */
+    case 0x03: case 0x04: case 0x0F: case 0x11: case 0x81: case 0x87:
+        return true;    /* audio */
+    case 0x06:
+        break;          /* private data: decide by descriptor */
+    default:
+        return false;
+    }
+
+    while (len >= 2) {
+        switch (desc[0]) {
+        case 0x56:      /* teletext */
+        case 0x59:      /* subtitling */
+        case 0x6A:      /* AC-3 */
+        case 0x7A:      /* E-AC-3 */
+        case 0x7C:      /* AAC */
+            return true;
+        }
+        len -= 2 + desc[1];
+        desc += 2 + desc[1];
+    }
+
+    return false;
+}
+
+// PMT section: collect PCR and wanted elementary PIDs
+static int aml_dvb_service_parse_pmt(struct aml_dvb_service *svc,
+                                     const u8 *sec, size_t len)
+{
+    u16 pids[AML_DVB_SERVICE_PIDS];
+    int n = 0, end, pos, info_len, i;
+    u16 pcr;
+
+    if (len < 16)
+        return -EINVAL;
+
+    end = min_t(int, 3 + (((sec[1] & 0x0F) << 8) | sec[2]), len) - 4;
+    pcr = ((sec[8] & 0x1F) << 8) | sec[9];
+    pos = 12 + (((sec[10] & 0x0F) << 8) | sec[11]);
+
+    if (pcr != AML_PID_NONE)
+        pids[n++] = pcr;
+
+    while (pos + 5 <= end && n < AML_DVB_SERVICE_PIDS) {
+        u16 pid = ((sec[pos + 1] & 0x1F) << 8) | sec[pos + 2];
+
+        info_len = ((sec[pos + 3] & 0x0F) << 8) | sec[pos + 4];
+        if (pos + 5 + info_len > end)
+            break;
+
+        if (aml_dvb_service_es_wanted(sec[pos], &sec[pos + 5], info_len)) {
+            for (i = 0; i < n; i++)
+                if (pids[i] == pid)
+                    break;
+            if (i == n)
+                pids[n++] = pid;
+        }
+        pos += 5 + info_len;
+    }
+
+    memcpy(svc->pids, pids, n * sizeof(pids[0]));
+    svc->npids = n;
+    return 0;
+}
+
+static int aml_dvb_service_pmt_cb(const u8 *buffer1, size_t buffer1_len,
+                                  const u8 *buffer2, size_t buffer2_len,
+                                  struct dmx_section_filter *source,
+                                  u32 *buffer_flags)
+{
+    struct aml_dvb *dvb = source->priv;
+    struct aml_dvb_service *svc = &dvb->service;
+    int version;
+
+    if (buffer1_len < 12 || !(buffer1[5] & 0x01))
+        return 0;
+
+    version = (buffer1[5] >> 1) & 0x1F;
+
+    spin_lock(&svc->lock);
+    if (version != svc->pmt_version &&
+        !aml_dvb_service_parse_pmt(svc, buffer1, buffer1_len)) {
+        svc->pmt_version = version;
+        schedule_work(&svc->work);
+    }
+    spin_unlock(&svc->lock);
+
+    return 0;
+}
+
+static int aml_dvb_service_pat_cb(const u8 *buffer1, size_t buffer1_len,
+                                  const u8 *buffer2, size_t buffer2_len,
+                                  struct dmx_section_filter *source,
+                                  u32 *buffer_flags)
+{
+    struct aml_dvb *dvb = source->priv;
+    struct aml_dvb_service *svc = &dvb->service;
+    int end, pos;
+
+    if (buffer1_len < 12 || !(buffer1[5] & 0x01))
+        return 0;
+
+    end = min_t(int, 3 + (((buffer1[1] & 0x0F) << 8) | buffer1[2]),
+                buffer1_len) - 4;
+
+    for (pos = 8; pos + 4 <= end; pos += 4) {
+        int program = (buffer1[pos] << 8) | buffer1[pos + 1];
+        u16 pid = ((buffer1[pos + 2] & 0x1F) << 8) | buffer1[pos + 3];
+
+        if (program != svc->program)
+            continue;
+
+        spin_lock(&svc->lock);
+        if (pid != svc->pmt_pid) {
+            svc->pmt_pid = pid;
+            svc->pmt_version = -1;
+            svc->npids = 0;
+            schedule_work(&svc->work);
+        }
+        spin_unlock(&svc->lock);
+        break;
+    }
+
+    return 0;
+}
+
+static int aml_dvb_service_open(struct aml_dvb *dvb,
+                                struct dmx_section_feed **feed,
+                                struct dmx_section_filter **filter,
+                                u16 pid, u8 table_id, int program,
+                                dmx_section_cb cb)
+{
+    struct dmx_demux *dmx = &dvb->demux.dmx;
+    int ret;
+
+    ret = dmx->allocate_section_feed(dmx, feed, cb);
+    if (ret < 0)
+        return ret;
+
+    ret = (*feed)->set(*feed, pid, 1);
+    if (ret < 0)
+        goto err_feed;
+
+    ret = (*feed)->allocate_filter(*feed, filter);
+    if (ret < 0)
+        goto err_feed;
+
+    memset((*filter)->filter_value, 0, DMX_MAX_FILTER_SIZE);
+    memset((*filter)->filter_mask, 0, DMX_MAX_FILTER_SIZE);
+    memset((*filter)->filter_mode, 0xFF, DMX_MAX_FILTER_SIZE);
+    (*filter)->filter_value[0] = table_id;
+    (*filter)->filter_mask[0] = 0xFF;
+    // Filter bytes map 1:1 onto the section; 1-2 are section_length
+    if (program >= 0) {
+        (*filter)->filter_value[3] = program >> 8;
+        (*filter)->filter_value[4] = program & 0xFF;
+        (*filter)->filter_mask[3] = 0xFF;
+        (*filter)->filter_mask[4] = 0xFF;
+    }
+    (*filter)->priv = dvb;
+
+    ret = (*feed)->start_filtering(*feed);
+    if (ret < 0)
+        goto err_filter;
+
+    return 0;
+
+err_filter:
+    (*feed)->release_filter(*feed, *filter);
+err_feed:
+    dmx->release_section_feed(dmx, *feed);
+    *feed = NULL;
+    return ret;
+}
+
+static void aml_dvb_service_close(struct aml_dvb *dvb,
+                                  struct dmx_section_feed **feed,
+                                  struct dmx_section_filter *filter)
+{
+    struct dmx_demux *dmx = &dvb->demux.dmx;
+
+    if (!*feed)
+        return;
+
+    (*feed)->stop_filtering(*feed);
+    (*feed)->release_filter(*feed, filter);
+    dmx->release_section_feed(dmx, *feed);
+    *feed = NULL;
+}
+
+// Reprogram the service slots in one PID set commit. Called with svc->mutex.
+static void aml_dvb_service_commit(struct aml_dvb *dvb)
+{
+    struct aml_dvb_service *svc = &dvb->service;
+    struct aml_pid_set *set;
+    u16 pids[AML_DVB_SERVICE_PIDS];
+    int i, n;
+
+    spin_lock_irq(&svc->lock);
+    n = svc->npids;
+    memcpy(pids, svc->pids, n * sizeof(pids[0]));
+    spin_unlock_irq(&svc->lock);
+
+    set = aml_dvb_pidset_begin(dvb);
+    for (i = 0; i < AML_DVB_SERVICE_PIDS; i++)
+        set->pid[AML_DVB_SERVICE_SLOT(dvb->variant) + i] =
+            i < n ? pids[i] : AML_PID_NONE;
+    aml_dvb_pidset_commit(dvb);
+
+    dvb_dbg(dvb, "Service %d: %d PIDs programmed\n", svc->program, n);
+}
+
+static void aml_dvb_service_work(struct work_struct *work)
+{
+    struct aml_dvb_service *svc = container_of(work, struct aml_dvb_service,
+                                               work);
+    struct aml_dvb *dvb = container_of(svc, struct aml_dvb, service);
+    u16 pmt_pid;
+
+    mutex_lock(&svc->mutex);
+    if (svc->program < 0)
+        goto out;
+
+    spin_lock_irq(&svc->lock);
+    pmt_pid = svc->pmt_pid;
+    spin_unlock_irq(&svc->lock);
+
+    // PMT moved (or first seen): follow it
+    if (pmt_pid != AML_PID_NONE && pmt_pid != svc->pmt_feed_pid) {
+        aml_dvb_service_close(dvb, &svc->pmt_feed, svc->pmt_filter);
+        svc->pmt_feed_pid = AML_PID_NONE;
+        if (!aml_dvb_service_open(dvb, &svc->pmt_feed, &svc->pmt_filter,
+                                  pmt_pid, PMT_TABLE_ID, svc->program,
+                                  aml_dvb_service_pmt_cb))
+            svc->pmt_feed_pid = pmt_pid;
+    }
+
+    aml_dvb_service_commit(dvb);
+out:
+    mutex_unlock(&svc->mutex);
+}
+
+int aml_dvb_service_init(struct aml_dvb *dvb)
+{
+    struct aml_dvb_service *svc = &dvb->service;
+
+    mutex_init(&svc->mutex);
+    spin_lock_init(&svc->lock);
+    INIT_WORK(&svc->work, aml_dvb_service_work);
+    svc->program = -1;
+    svc->pmt_pid = AML_PID_NONE;
+    svc->pmt_feed_pid = AML_PID_NONE;
+    svc->pmt_version = -1;
+
+    return 0;
+}
+EXPORT_SYMBOL(aml_dvb_service_init);
+
+void aml_dvb_service_stop(struct aml_dvb *dvb)
+{
+    struct aml_dvb_service *svc = &dvb->service;
+
+    mutex_lock(&svc->mutex);
+    if (svc->program < 0) {
+        mutex_unlock(&svc->mutex);
+        return;
+    }
+
+    aml_dvb_service_close(dvb, &svc->pat_feed, svc->pat_filter);
+    aml_dvb_service_close(dvb, &svc->pmt_feed, svc->pmt_filter);
+    svc->program = -1;
+    mutex_unlock(&svc->mutex);
+
+    cancel_work_sync(&svc->work);
+
+    mutex_lock(&svc->mutex);
+    spin_lock_irq(&svc->lock);
+    svc->pmt_pid = AML_PID_NONE;
+    svc->pmt_version = -1;
+    svc->npids = 0;
+    spin_unlock_irq(&svc->lock);
+    svc->pmt_feed_pid = AML_PID_NONE;
+    aml_dvb_service_commit(dvb);
+    mutex_unlock(&svc->mutex);
+}
+EXPORT_SYMBOL(aml_dvb_service_stop);
+
+// Select a program: PAT/PMT tracking and PID programming follow from here
+int aml_dvb_service_start(struct aml_dvb *dvb, int program)
+{
+    struct aml_dvb_service *svc = &dvb->service;
+    int ret;
+
+    if (program < 1 || program > 0xFFFF)
+        return -EINVAL;
+
+    aml_dvb_service_stop(dvb);
+
+    mutex_lock(&svc->mutex);
+    svc->program = program;
+    ret = aml_dvb_service_open(dvb, &svc->pat_feed, &svc->pat_filter,
+                               PAT_PID, PAT_TABLE_ID, -1,
+                               aml_dvb_service_pat_cb);
+    if (ret)
+        svc->program = -1;
+    mutex_unlock(&svc->mutex);
+
+    if (!ret)
+        dvb_info(dvb, "Service filter: program %d\n", program);
+    return ret;
+}
+EXPORT_SYMBOL(aml_dvb_service_start);
+
+MODULE_DESCRIPTION("Amlogic DVB Service Filter");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,778 @@
+// sources/aml_dvb/aml_dvb_sysfs.c
+// sysfs statistics and tunables, attached to the platform device
+
+#include <linux/device.h>
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/pm_runtime.h>
+#include <linux/sysfs.h>
+#include "aml_dvb.h"
+
+static ssize_t pid_commits_show(struct device *dev,
+                                struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%u\n", dvb->pid_commits);
+}
+static DEVICE_ATTR_RO(pid_commits);
+
+// Last and worst-case PID set commit time (bank write + flip), in ns
+static ssize_t pid_commit_ns_show(struct device *dev,
+                                  struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%llu %llu\n", dvb->pid_commit_ns,
+                      dvb->pid_commit_max_ns);
+}
+static DEVICE_ATTR_RO(pid_commit_ns);
+
+// Service filter: write a program_number to select, -1 to stop
+static ssize_t service_show(struct device *dev,
+                            struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    struct aml_dvb_service *svc = &dvb->service;
+    ssize_t len;
+    int i;
+
+    spin_lock_irq(&svc->lock);
+    len = sysfs_emit(buf, "%d pmt=0x%04x version=%d pids=", svc->program,
+                     svc->pmt_pid, svc->pmt_version);
+    for (i = 0; i < svc->npids; i++)
+        len += sysfs_emit_at(buf, len, "%s0x%04x", i ? "," : "",
+                             svc->pids[i]);
+    spin_unlock_irq(&svc->lock);
+
+    len += sysfs_emit_at(buf, len, "\n");
+    return len;
+}
+
+static ssize_t service_store(struct device *dev,
+                             struct device_attribute *attr,
+                             const char *buf, size_t count)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    int program, ret;
+
+    ret = kstrtoint(buf, 0, &program);
+    if (ret)
+        return ret;
+
+    if (program < 0) {
+        aml_dvb_service_stop(dvb);
+        return count;
+    }
+
+    ret = aml_dvb_service_start(dvb, program);
+    return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(service);
+
+// Cached sections and sections answered from the cache
+static ssize_t section_cache_show(struct device *dev,
+                                  struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    struct aml_dmx_sec_cache *cache = &dvb->sec_cache;
+    ssize_t len;
+
+    spin_lock_irq(&cache->lock);
+    len = sysfs_emit(buf, "tsid=%d sections=%d hits=%u\n", cache->tsid,
+                     cache->count, cache->hits);
+    spin_unlock_irq(&cache->lock);
+
+    return len;
+}
+
+static ssize_t section_cache_store(struct device *dev,
+                                   struct device_attribute *attr,
+                                   const char *buf, size_t count)
+{
+    aml_dmx_section_cache_flush(dev_get_drvdata(dev));
+    return count;
+}
+static DEVICE_ATTR_RW(section_cache);
+
+// Suppression ratio over the filters set with DMX_DELIVER_ON_CHANGE
+static ssize_t section_dedup_show(struct device *dev,
+                                  struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    struct aml_dmx_sec_dedup *dd = &dvb->sec_dedup;
+    u64 delivered, suppressed, permille = 0;
+    unsigned int count;
+
+    spin_lock_irq(&dd->lock);
+    delivered = dd->delivered;
+    suppressed = dd->suppressed;
+    count = dd->count;
+    spin_unlock_irq(&dd->lock);
+
+    if (delivered + suppressed)
+        permille = div64_u64(suppressed * 1000, delivered + suppressed);
+
+    return sysfs_emit(buf,
+                      "tracked=%u delivered=%llu suppressed=%llu ratio=%llu.%llu%%\n",
+                      count, delivered, suppressed, permille / 10,
+                      permille % 10);
+}
+static DEVICE_ATTR_RO(section_dedup);
+
+// Section CRC: hardware/software checks, then "<pid> <errors>" per feed
+static ssize_t crc_errors_show(struct device *dev,
+                               struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    struct aml_dmx_crc_stats *st = &dvb->crc_stats;
+    struct dvb_demux *demux = &dvb->demux;
+    ssize_t len;
+    int i;
+
+    len = sysfs_emit(buf,
+                     "hw_checked=%llu sw_checked=%llu unmatched=%llu errors=%llu\n",
+                     st->hw_checked, st->sw_checked, st->unmatched,
+                     st->errors);
+
+    mutex_lock(&demux->mutex);
+    for (i = 0; i < demux->feednum; i++) {
+        struct dvb_demux_feed *feed = &demux->feed[i];
+
+        if (feed->state < DMX_STATE_READY || feed->type != DMX_TYPE_SEC)
+            continue;
+        len += sysfs_emit_at(buf, len, "0x%04x %u\n", feed->pid,
+                             dvb->sec_feed[i].crc_errors);
+    }
+    mutex_unlock(&demux->mutex);
+
+    return len;
+}
+static DEVICE_ATTR_RO(crc_errors);
+
+// DMA ring: bytes delivered, DMA-done interrupts, latency flushes, overflows
+static ssize_t dma_stats_show(struct device *dev,
+                              struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    struct aml_dvb_dma_stats *st = &dvb->dma_stats;
+
+    return sysfs_emit(buf, "bytes=%llu irqs=%u timeouts=%u overflows=%u\n",
+                      st->bytes, st->irqs, st->timeouts, st->overflows);
+}
+static DEVICE_ATTR_RO(dma_stats);
+
+// 1 = raw TS output as 192-byte packets with a 4-byte arrival timestamp
+static ssize_t ts_timestamp_show(struct device *dev,
+                                 struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%d\n", dvb->tsstamp.enable);
+}
+
+static ssize_t ts_timestamp_store(struct device *dev,
+                                  struct device_attribute *attr,
+                                  const char *buf, size_t count)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    bool enable;
+    int ret;
+
+    ret = kstrtobool(buf, &enable);
+    if (ret)
+        return ret;
+
+    dvb->tsstamp.enable = enable;
+    return count;
+}
+static DEVICE_ATTR_RW(ts_timestamp);
+
+// TS input: mode, clock polarity, detection state and last sweep rates
+static ssize_t ts_input_show(struct device *dev,
+                             struct device_attribute *attr, char *buf)
+{
+    static const char * const states[] = {
+        [AML_TS_DETECT_FIXED] = "fixed",
+        [AML_TS_DETECT_PENDING] = "pending",
+        [AML_TS_DETECT_PROBING] = "probing",
+        [AML_TS_DETECT_LOCKED] = "detected",
+    };
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    struct aml_dvb_tsdetect *td = &dvb->tsdetect;
+
+    return sysfs_emit(buf, "mode=%d clk_pol=%d state=%s rates=%u,%u,%u,%u\n",
+                      td->mode, td->clk_pol, states[td->state], td->rate[0],
+                      td->rate[1], td->rate[2], td->rate[3]);
+}
+
+// "<mode> [clk_pol]": 0 = autodetect again, 1 = serial, 2 = parallel
+static ssize_t ts_input_store(struct device *dev,
+                              struct device_attribute *attr,
+                              const char *buf, size_t count)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    int mode, clk_pol = -1, ret;
+
+    if (sscanf(buf, "%d %d", &mode, &clk_pol) < 1)
+        return -EINVAL;
+
+    ret = aml_dvb_tsdetect_set(dvb, mode, clk_pol);
+    return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(ts_input);
+
+// demux0 DMA ring size in KB; the ring is swapped without closing the
+// demux. Secondary channel rings are fixed.
+static ssize_t dma_buffer_kb_show(struct device *dev,
+                                  struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%zu\n", dvb->dma_size / 1024);
+}
+
+static ssize_t dma_buffer_kb_store(struct device *dev,
+                                   struct device_attribute *attr,
+                                   const char *buf, size_t count)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    unsigned int kb;
+    int ret;
+
+    ret = kstrtouint(buf, 0, &kb);
+    if (ret)
+        return ret;
+
+    ret = aml_dvb_dma_reconfig(dvb, (size_t)kb * 1024, dvb->irq_coalesce_us,
+                               dvb->dma_sg);
+    return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(dma_buffer_kb);
+
+// Minimum gap between DMA-done interrupts in us (0 = every segment)
+static ssize_t irq_coalesce_us_show(struct device *dev,
+                                    struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%u\n", dvb->irq_coalesce_us);
+}
+
+static ssize_t irq_coalesce_us_store(struct device *dev,
+                                     struct device_attribute *attr,
+                                     const char *buf, size_t count)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    unsigned int us;
+    int ret;
+
+    ret = kstrtouint(buf, 0, &us);
+    if (ret)
+        return ret;
+
+    ret = aml_dvb_dma_reconfig(dvb, dvb->dma_size, us, dvb->dma_sg);
+    return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(irq_coalesce_us);
+
+// Flush partial DMA segments after this many ms (0 = on DMA-done only)
+static ssize_t max_latency_ms_show(struct device *dev,
+                                   struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%u\n", dvb->max_latency_ms);
+}
+
+static ssize_t max_latency_ms_store(struct device *dev,
+                                    struct device_attribute *attr,
+                                    const char *buf, size_t count)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    unsigned int ms;
+    int ret;
+
+    ret = kstrtouint(buf, 0, &ms);
+    if (ret)
+        return ret;
+
+    ret = aml_dvb_dma_set_latency(dvb, ms);
+    return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(max_latency_ms);
+
+static ssize_t dma_sg_show(struct device *dev,
+                           struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%d\n", dvb->dma_sg);
+}
+
+static ssize_t dma_sg_store(struct device *dev, struct device_attribute *attr,
+                            const char *buf, size_t count)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    bool sg;
+    int ret;
+
+    ret = kstrtobool(buf, &sg);
+    if (ret)
+        return ret;
+    if (sg && !dvb->variant->dma_sg)
+        return -EOPNOTSUPP;
+
+    ret = aml_dvb_dma_reconfig(dvb, dvb->dma_size, dvb->irq_coalesce_us, sg);
+    return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(dma_sg);
+
+// Secondary demux channels: one line per demuxN
+static ssize_t demux_channels_show(struct device *dev,
+                                   struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    ssize_t len = 0;
+    int i;
+
+    for (i = 0; i < AML_DVB_MAX_DEMUX - 1; i++) {
+        struct aml_dvb_chan *ch = &dvb->chan[i];
+
+        if (!ch->registered)
+            continue;
+        len += sysfs_emit_at(buf, len,
+                             "demux%d bytes=%llu irqs=%u overflows=%u\n",
+                             ch->id, ch->dma_stats.bytes, ch->dma_stats.irqs,
+                             ch->dma_stats.overflows);
+    }
+
+    return len;
+}
+static DEVICE_ATTR_RO(demux_channels);
+
+// Fan-out dvr: open readers, bytes through the shared ring, reader laps
+static ssize_t dvr_fanout_show(struct device *dev,
+                               struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    struct aml_dvr_fanout *fo = dvb->fanout;
+
+    if (!fo)
+        return sysfs_emit(buf, "readers=0\n");
+
+    return sysfs_emit(buf, "readers=%d bytes=%llu size=%zu overflows=%u\n",
+                      atomic_read(&fo->readers), fo->head, fo->size,
+                      fo->overflows);
+}
+static DEVICE_ATTR_RO(dvr_fanout);
+
+static ssize_t boot_timing_emit(char *buf, ssize_t len, const char *name,
+                                u64 ns)
+{
+    const char *sep = len ? " " : "";
+
+    if (!ns)
+        return sysfs_emit_at(buf, len, "%s%s=-", sep, name);
+
+    return sysfs_emit_at(buf, len, "%s%s=%llu", sep, name,
+                         div_u64(ns, NSEC_PER_MSEC));
+}
+
+// Milestones in ms since boot: probe entry, nodes registered, hardware
+// running, first feed, first frontend lock, first packets into the
+// demux ("-" while not reached yet).
+static ssize_t boot_timing_show(struct device *dev,
+                                struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    struct aml_dvb_bringup *bu = &dvb->bringup;
+    ssize_t len = 0;
+
+    len += boot_timing_emit(buf, len, "probe", bu->probe_ns);
+    len += boot_timing_emit(buf, len, "nodes", bu->nodes_ns);
+    len += boot_timing_emit(buf, len, "hw", bu->hw_ns);
+    len += boot_timing_emit(buf, len, "first_feed", bu->first_feed_ns);
+    len += boot_timing_emit(buf, len, "first_lock", bu->first_lock_ns);
+    len += boot_timing_emit(buf, len, "first_data", bu->first_data_ns);
+    len += sysfs_emit_at(buf, len, "\n");
+
+    return len;
+}
+static DEVICE_ATTR_RO(boot_timing);
+
+// Runtime PM: current state, suspend/resume counts and resume latency.
+// Idle residency is in power/runtime_suspended_time (ms).
+static ssize_t runtime_pm_show(struct device *dev,
+                               struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    struct aml_dvb_pm_stats *st = &dvb->pm_stats;
+
+    return sysfs_emit(buf,
+                      "%s suspends=%u resumes=%u resume_us=%llu resume_max_us=%llu\n",
+                      pm_runtime_suspended(dev) ? "suspended" : "active",
+                      st->suspends, st->resumes,
+                      div_u64(st->resume_ns, NSEC_PER_USEC),
+                      div_u64(st->resume_max_ns, NSEC_PER_USEC));
+}
+static DEVICE_ATTR_RO(runtime_pm);
+
+// Frontend register cache: bus transactions and time, cache effect,
+// last tune. Empty while no frontend is attached.
+static ssize_t frontend_i2c_show(struct device *dev,
+                                 struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    struct aml_fe_i2c *fc = &dvb->fe_i2c;
+    struct aml_fe_i2c_stats *st = &fc->stats;
+
+    if (!fc->map)
+        return sysfs_emit(buf, "none\n");
+
+    return sysfs_emit(buf,
+                      "addr=0x%02x xfers=%llu bus_us=%llu read_hits=%llu write_skips=%llu merged=%u tunes=%u last_tune_us=%llu last_tune_xfers=%u\n",
+                      fc->addr, st->xfers, div_u64(st->bus_ns, NSEC_PER_USEC),
+                      st->read_hits, st->write_skips, st->merged, st->tunes,
+                      div_u64(st->tune_ns, NSEC_PER_USEC), st->tune_xfers);
+}
+static DEVICE_ATTR_RO(frontend_i2c);
+
+// Write a tune count to run the emulated tune benchmark; read back the
+// per-tune transactions and bus time without and with the cache
+static ssize_t frontend_i2c_bench_show(struct device *dev,
+                                       struct device_attribute *attr,
+                                       char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    struct aml_fe_i2c_bench *b = &dvb->fe_bench;
+    unsigned int n = max(b->tunes, 1U);
+
+    return sysfs_emit(buf,
+                      "tunes=%u uncached: xfers=%llu bus_us=%llu cached: xfers=%llu bus_us=%llu\n",
+                      b->tunes, div_u64(b->xfers[0], n),
+                      div_u64(b->bus_ns[0], n * NSEC_PER_USEC),
+                      div_u64(b->xfers[1], n),
+                      div_u64(b->bus_ns[1], n * NSEC_PER_USEC));
+}
+
+static ssize_t frontend_i2c_bench_store(struct device *dev,
+                                        struct device_attribute *attr,
+                                        const char *buf, size_t count)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    unsigned int tunes;
+    int ret;
+
+    ret = kstrtouint(buf, 0, &tunes);
+    if (ret)
+        return ret;
+    if (!tunes || tunes > 10000)
+        return -EINVAL;
+
+    ret = aml_fe_i2c_bench(dvb, tunes);
+    return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(frontend_i2c_bench);
+
+// Frontend lock poll: cached status and statistics, tune-to-lock time
+static ssize_t frontend_lock_show(struct device *dev,
+                                  struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    struct aml_fe_lock *fl = &dvb->fe_lock;
+
+    if (!fl->fe)
+        return sysfs_emit(buf, "none\n");
+
+    return sysfs_emit(buf,
+                      "status=0x%02x tunes=%u locks=%u polls=%u lock_us=%llu lock_max_us=%llu strength=%u snr=%u ber=%u ucb=%u\n",
+                      fl->status, fl->tunes, fl->locks, fl->polls,
+                      div_u64(fl->lock_ns, NSEC_PER_USEC),
+                      div_u64(fl->lock_max_ns, NSEC_PER_USEC),
+                      fl->strength, fl->snr, fl->ber, fl->ucb);
+}
+static DEVICE_ATTR_RO(frontend_lock);
+
+static const char *aml_lnb_voltage_name(int voltage)
+{
+    switch (voltage) {
+    case SEC_VOLTAGE_13:
+        return "13";
+    case SEC_VOLTAGE_18:
+        return "18";
+    case SEC_VOLTAGE_OFF:
+        return "off";
+    default:
+        return "-";
+    }
+}
+
+// LNB state as last set, armed switches done and steps left out
+static ssize_t lnb_show(struct device *dev, struct device_attribute *attr,
+                        char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    struct aml_fe_sec *sec = &dvb->fe_sec;
+
+    if (!sec->fe)
+        return sysfs_emit(buf, "none\n");
+
+    return sysfs_emit(buf,
+                      "voltage=%s tone=%s switches=%u skipped=%u switch_us=%llu switch_max_us=%llu\n",
+                      aml_lnb_voltage_name(sec->voltage),
+                      sec->tone < 0 ? "-" :
+                      sec->tone == SEC_TONE_ON ? "on" : "off",
+                      sec->switches, sec->skipped,
+                      div_u64(sec->switch_ns, NSEC_PER_USEC),
+                      div_u64(sec->switch_max_ns, NSEC_PER_USEC));
+}
+static DEVICE_ATTR_RO(lnb);
+
+// Last spectrum/blind scan; write a step in kHz to run an emulated scan
+static ssize_t frontend_scan_show(struct device *dev,
+                                  struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    struct aml_fe_scan *scan = &dvb->fe_scan;
+
+    return sysfs_emit(buf,
+                      "%s%s points=%u candidates=%u locked=%u expected=%u sweep_ms=%u total_ms=%u\n",
+                      READ_ONCE(scan->running) ? "running" : "idle",
+                      scan->emu ? " emulated" : "",
+                      scan->points, scan->candidates, scan->locked,
+                      scan->emu ? scan->expected : 0,
+                      scan->sweep_ms, scan->total_ms);
+}
+
+static ssize_t frontend_scan_store(struct device *dev,
+                                   struct device_attribute *attr,
+                                   const char *buf, size_t count)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    unsigned int step;
+    int ret;
+
+    ret = kstrtouint(buf, 0, &step);
+    if (ret)
+        return ret;
+    if (step < 300 || step > 10000)
+        return -EINVAL;
+
+    ret = aml_fe_scan_bench(dvb, step);
+    return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(frontend_scan);
+
+// Write "<interface> <datagrams>" to push a synthetic MPE stream through
+// a dvb_net interface that is up; read back rate and CPU cost
+static ssize_t net_bench_show(struct device *dev,
+                              struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    struct aml_dvb_net_bench *b = &dvb->net_bench;
+    u64 us = max_t(u64, div_u64(b->cpu_ns, NSEC_PER_USEC), 1);
+
+    return sysfs_emit(buf,
+                      "datagrams=%u delivered=%u pps=%llu mbit_s=%llu cpu_us_per_mbit=%llu\n",
+                      b->datagrams, b->delivered,
+                      div64_u64((u64)b->delivered * USEC_PER_SEC, us),
+                      div64_u64(b->bytes * 8, us),
+                      b->bytes ? div64_u64(b->cpu_ns * 1000, b->bytes * 8) : 0);
+}
+
+static ssize_t net_bench_store(struct device *dev,
+                               struct device_attribute *attr,
+                               const char *buf, size_t count)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    unsigned int ifnum, datagrams;
+    int ret;
+
+    if (sscanf(buf, "%u %u", &ifnum, &datagrams) != 2)
+        return -EINVAL;
+    if (!datagrams || datagrams > 1000000)
+        return -EINVAL;
+
+    ret = aml_dvb_net_bench(dvb, ifnum, datagrams);
+    return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(net_bench);
+
+// SoC variants: capabilities and register layout check, '*' = this one
+static ssize_t hw_variants_show(struct device *dev,
+                                struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    const struct aml_dvb_variant *v;
+    ssize_t len = 0;
+    u32 at;
+    int i, ret;
+
+    for (i = 0; i < AML_DVB_HW_COUNT; i++) {
+        v = &aml_dvb_variants[i];
+        ret = aml_dvb_reg_layout_check(v, &at);
+        len += sysfs_emit_at(buf, len,
+                             "%c%s pid_slots=%u sec_filters=%u ts_inputs=%u demux_cores=%u dma_sg=%d dma_timeout=%d dma_max_kb=%u layout=",
+                             v == dvb->variant ? '*' : ' ', v->name,
+                             v->pid_slots, v->sec_filters, v->ts_inputs,
+                             v->demux_cores, v->dma_sg, v->dma_timeout,
+                             v->dma_max / 1024);
+        if (ret)
+            len += sysfs_emit_at(buf, len, "%d@0x%x\n", ret, at);
+        else
+            len += sysfs_emit_at(buf, len, "ok\n");
+    }
+
+    return len;
+}
+static DEVICE_ATTR_RO(hw_variants);
+
+// Decoder sink for DMX_OUT_DECODER feeds started afterwards ("none" = off)
+static ssize_t decoder_show(struct device *dev,
+                            struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+
+    return aml_dvb_decoder_show(dvb, buf);
+}
+
+static ssize_t decoder_store(struct device *dev,
+                             struct device_attribute *attr,
+                             const char *buf, size_t count)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    char name[AML_DVB_DEC_NAME_LEN];
+    int ret;
+
+    if (strscpy(name, buf, sizeof(name)) < 0)
+        return -EINVAL;
+
+    ret = aml_dvb_decoder_select(dvb, strim(name));
+    return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(decoder);
+
+// Write a packet count to push synthetic video PES through the sink
+static ssize_t decoder_bench_show(struct device *dev,
+                                  struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    struct aml_dvb_dec_bench *b = &dvb->dec_bench;
+
+    return sysfs_emit(buf,
+                      "packets=%u delivered=%llu handoffs=%llu ns_per_packet=%llu\n",
+                      b->packets, b->delivered, b->handoffs,
+                      b->packets ? div_u64(b->cpu_ns, b->packets) : 0);
+}
+
+static ssize_t decoder_bench_store(struct device *dev,
+                                   struct device_attribute *attr,
+                                   const char *buf, size_t count)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    unsigned int packets;
+    int ret;
+
+    ret = kstrtouint(buf, 0, &packets);
+    if (ret)
+        return ret;
+    if (!packets || packets > 10000000)
+        return -EINVAL;
+
+    ret = aml_dvb_decoder_bench(dvb, packets);
+    return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(decoder_bench);
+
+// Receive pre-filter per demux, PIDs with CC gaps; write to reset
+static ssize_t prefilter_show(struct device *dev,
+                              struct device_attribute *attr, char *buf)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    ssize_t len;
+    int i;
+
+    len = aml_dmx_prefilter_show(&dvb->prefilter, "demux0", buf, 0);
+
+    for (i = 0; i < AML_DVB_MAX_DEMUX - 1; i++) {
+        struct aml_dvb_chan *ch = &dvb->chan[i];
+        char name[8];
+
+        if (!ch->registered)
+            continue;
+        snprintf(name, sizeof(name), "demux%d", ch->id);
+        len = aml_dmx_prefilter_show(&ch->prefilter, name, buf, len);
+    }
+
+    return len;
+}
+
+static ssize_t prefilter_store(struct device *dev,
+                               struct device_attribute *attr,
+                               const char *buf, size_t count)
+{
+    struct aml_dvb *dvb = dev_get_drvdata(dev);
+    unsigned long flags;
+    int i;
+
+    spin_lock_irqsave(&dvb->dma_lock, flags);
+    aml_dmx_prefilter_reset(&dvb->prefilter);
+    spin_unlock_irqrestore(&dvb->dma_lock, flags);
+
+    for (i = 0; i < AML_DVB_MAX_DEMUX - 1; i++) {
+        struct aml_dvb_chan *ch = &dvb->chan[i];
+
+        if (!ch->registered)
+            continue;
+        spin_lock_irqsave(&ch->dma_lock, flags);
+        aml_dmx_prefilter_reset(&ch->prefilter);
+        spin_unlock_irqrestore(&ch->dma_lock, flags);
+    }
+
+    return count;
+}
+static DEVICE_ATTR_RW(prefilter);
+
+static struct attribute *aml_dvb_attrs[] = {
+    &dev_attr_pid_commits.attr,
+    &dev_attr_pid_commit_ns.attr,
+    &dev_attr_service.attr,
+    &dev_attr_section_cache.attr,
+    &dev_attr_section_dedup.attr,
+    &dev_attr_crc_errors.attr,
+    &dev_attr_dma_stats.attr,
+    &dev_attr_ts_timestamp.attr,
+    &dev_attr_ts_input.attr,
+    &dev_attr_dma_buffer_kb.attr,
+    &dev_attr_irq_coalesce_us.attr,
+    &dev_attr_max_latency_ms.attr,
+    &dev_attr_dma_sg.attr,
+    &dev_attr_demux_channels.attr,
+    &dev_attr_dvr_fanout.attr,
+    &dev_attr_boot_timing.attr,
+    &dev_attr_runtime_pm.attr,
+    &dev_attr_frontend_i2c.attr,
+    &dev_attr_frontend_i2c_bench.attr,
+    &dev_attr_frontend_lock.attr,
+    &dev_attr_lnb.attr,
+    &dev_attr_frontend_scan.attr,
+    &dev_attr_net_bench.attr,
+    &dev_attr_decoder.attr,
+    &dev_attr_hw_variants.attr,
+    &dev_attr_decoder_bench.attr,
+    &dev_attr_prefilter.attr,
+    NULL,
+};
+
+const struct attribute_group aml_dvb_attr_group = {
+    .attrs = aml_dvb_attrs,
+};
+EXPORT_SYMBOL(aml_dvb_attr_group);
+
+// Driver dev_groups: the core creates them before the bind uevent
+const struct attribute_group *aml_dvb_attr_groups[] = {
+    &aml_dvb_attr_group,
+    NULL,
+};
+EXPORT_SYMBOL(aml_dvb_attr_groups);
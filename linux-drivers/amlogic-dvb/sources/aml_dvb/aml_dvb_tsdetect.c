@@ -0,0 +1,321 @@
+// sources/aml_dvb/aml_dvb_tsdetect.c
+// TS_MODE_AUTO: find the TS input format by measuring sync lock
+//
+// With ts-mode = 0 the input is probed once a stream can be present
+// (first feed start after tuning). The input as configured is measured
+// first on the live stream, counting packets that start with the 0x47
+// sync byte while feeds keep receiving; if it is clean it is kept. Only
+// otherwise is every serial/parallel and clock polarity combination
+// applied for a short window, with the DMA drains of all demuxes
+// counting or discarding instead of delivering. The result is kept and
+// announced with a
+// change uevent carrying AML_TS_MODE/AML_TS_CLK_POL, which udev stores
+// as module options so later boots start in the right mode.
+
+#include <linux/module.h>
+#include <linux/delay.h>
+#include <linux/kobject.h>
+#include <linux/pm_runtime.h>
+#include <linux/workqueue.h>
+#include "aml_dvb.h"
+
+static int ts_mode = -1;
+module_param(ts_mode, int, 0444);
+MODULE_PARM_DESC(ts_mode,
+                 "TS input: -1 = device tree, 0 = auto, 1 = serial, 2 = parallel");
+
+static int ts_clk_pol = -1;
+module_param(ts_clk_pol, int, 0444);
+MODULE_PARM_DESC(ts_clk_pol, "TS clock polarity: -1 = device tree, 0, 1");
+
+static unsigned int ts_detect_window_ms = 100;
+module_param(ts_detect_window_ms, uint, 0644);
+MODULE_PARM_DESC(ts_detect_window_ms,
+                 "Measurement window per TS input candidate (ms)");
+
+#define AML_TS_DETECT_SETTLE_MS 20
+#define AML_TS_DETECT_RETRY_MS  2000
+#define AML_TS_DETECT_RETRIES   10
+
+/* Fewer synced packets than this per window means no stream */
+#define AML_TS_DETECT_MIN_SYNC  16
+
+static const struct {
+    int mode;
+    int clk_pol;
+} aml_ts_candidates[AML_TS_CANDIDATES] = {
+    { TS_MODE_SERIAL, 0 },
+    { TS_MODE_SERIAL, 1 },
+    { TS_MODE_PARALLEL, 0 },
+    { TS_MODE_PARALLEL, 1 },
+};
+
+static const char *aml_ts_mode_name(int mode)
+{
+    return mode == TS_MODE_PARALLEL ? "parallel" : "serial";
+}
+
+// From the DMA drain, under dma_lock. True while probing: data is not
+// delivered, so the demux never sees a misaligned stream.
+bool aml_dvb_tsdetect_count(struct aml_dvb *dvb, const u8 *buf,
+                            unsigned int count)
+{
+    struct aml_dvb_tsdetect *td = &dvb->tsdetect;
+    unsigned int i;
+
+    if (!td->counting)
+        return false;
+
+    for (i = 0; i < count; i++) {
+        if (buf[i * TS_PACKET_SIZE] == 0x47)
+            td->sync++;
+        else
+            td->bad++;
+    }
+
+    return td->probing;
+}
+EXPORT_SYMBOL(aml_dvb_tsdetect_count);
+
+// A real lock is nearly all synced packets, not a lucky few
+static bool aml_dvb_tsdetect_clean(u32 sync, u32 bad)
+{
+    return sync >= AML_TS_DETECT_MIN_SYNC && sync > 8 * bad;
+}
+
+// Count synced packets over one window of the input as it is now
+static u32 aml_dvb_tsdetect_window(struct aml_dvb *dvb, u32 *bad)
+{
+    struct aml_dvb_tsdetect *td = &dvb->tsdetect;
+    u32 sync;
+
+    // Drop (or deliver) what arrived before, then count a clean window
+    aml_dvb_dma_process(dvb);
+    spin_lock_irq(&dvb->dma_lock);
+    td->sync = 0;
+    td->bad = 0;
+    spin_unlock_irq(&dvb->dma_lock);
+
+    msleep(ts_detect_window_ms);
+    aml_dvb_dma_process(dvb);
+
+    spin_lock_irq(&dvb->dma_lock);
+    sync = td->sync;
+    *bad = td->bad;
+    spin_unlock_irq(&dvb->dma_lock);
+
+    return sync;
+}
+
+// Apply one candidate and measure its synced packet rate
+static u32 aml_dvb_tsdetect_measure(struct aml_dvb *dvb, int i, u32 *bad)
+{
+    aml_dvb_reg_set_ts_input(dvb, aml_ts_candidates[i].mode,
+                             aml_ts_candidates[i].clk_pol);
+    msleep(AML_TS_DETECT_SETTLE_MS);
+
+    return aml_dvb_tsdetect_window(dvb, bad);
+}
+
+// Candidate index of the input as configured
+static int aml_dvb_tsdetect_current(struct aml_dvb_tsdetect *td)
+{
+    int i;
+
+    for (i = 0; i < AML_TS_CANDIDATES; i++)
+        if (aml_ts_candidates[i].mode == td->mode &&
+            aml_ts_candidates[i].clk_pol == td->clk_pol)
+            return i;
+
+    return 0;
+}
+
+static void aml_dvb_tsdetect_work(struct work_struct *work)
+{
+    struct aml_dvb_tsdetect *td = container_of(to_delayed_work(work),
+                                               struct aml_dvb_tsdetect, work);
+    struct aml_dvb *dvb = container_of(td, struct aml_dvb, tsdetect);
+    char mode_env[24], pol_env[24];
+    char *envp[] = { mode_env, pol_env, NULL };
+    u32 sync, bad, best_sync = 0;
+    int i, best = -1, in_use;
+
+    // Only with a feed running: no stream to measure otherwise, and the
+    // block may be gated. The next feed start kicks the probe again.
+    // -EINVAL: runtime PM is off (CONFIG_PM=n, or not enabled yet during
+    // the bring-up) and the block is powered, so go ahead without a ref.
+    in_use = pm_runtime_get_if_in_use(dvb->dev);
+    if (!in_use || (in_use < 0 && in_use != -EINVAL))
+        return;
+
+    // Keep live DMA reconfiguration out of the sweep
+    mutex_lock(&dvb->dma_cfg_lock);
+    td->state = AML_TS_DETECT_PROBING;
+    td->attempts++;
+
+    spin_lock_irq(&dvb->dma_lock);
+    td->counting = true;
+    spin_unlock_irq(&dvb->dma_lock);
+
+    // The input as configured may be right already: check it on the live
+    // stream, without holding data back from the feeds
+    i = aml_dvb_tsdetect_current(td);
+    sync = aml_dvb_tsdetect_window(dvb, &bad);
+    td->rate[i] = sync * 1000 / max(ts_detect_window_ms, 1U);
+    if (aml_dvb_tsdetect_clean(sync, bad)) {
+        best = i;
+    } else {
+        spin_lock_irq(&dvb->dma_lock);
+        td->probing = true;
+        spin_unlock_irq(&dvb->dma_lock);
+
+        for (i = 0; i < AML_TS_CANDIDATES; i++) {
+            sync = aml_dvb_tsdetect_measure(dvb, i, &bad);
+            td->rate[i] = sync * 1000 / max(ts_detect_window_ms, 1U);
+
+            if (aml_dvb_tsdetect_clean(sync, bad) && sync > best_sync) {
+                best = i;
+                best_sync = sync;
+            }
+        }
+    }
+
+    if (best >= 0) {
+        td->mode = aml_ts_candidates[best].mode;
+        td->clk_pol = aml_ts_candidates[best].clk_pol;
+        td->state = AML_TS_DETECT_LOCKED;
+    } else {
+        td->state = AML_TS_DETECT_PENDING;
+    }
+
+    aml_dvb_reg_set_ts_input(dvb, td->mode, td->clk_pol);
+    spin_lock_irq(&dvb->dma_lock);
+    td->probing = false;
+    td->counting = false;
+    spin_unlock_irq(&dvb->dma_lock);
+    mutex_unlock(&dvb->dma_cfg_lock);
+    if (in_use > 0)
+        aml_dvb_pm_put(dvb);
+
+    if (best < 0) {
+        dvb_dbg(dvb, "TS autodetect: no stream yet (attempt %u)\n",
+                td->attempts);
+        if (td->attempts < AML_TS_DETECT_RETRIES)
+            schedule_delayed_work(&td->work,
+                                  msecs_to_jiffies(AML_TS_DETECT_RETRY_MS));
+        return;
+    }
+
+    dvb->ts_mode = td->mode;
+    dvb->ts_clk_pol = td->clk_pol;
+    dvb_info(dvb, "TS autodetect: %s, clock polarity %d (%u pkt/s)\n",
+             aml_ts_mode_name(td->mode), td->clk_pol, td->rate[best]);
+
+    snprintf(mode_env, sizeof(mode_env), "AML_TS_MODE=%d", td->mode);
+    snprintf(pol_env, sizeof(pol_env), "AML_TS_CLK_POL=%d", td->clk_pol);
+    kobject_uevent_env(&dvb->dev->kobj, KOBJ_CHANGE, envp);
+}
+
+// A feed started: a stream may be there now, probe if still undecided.
+// A series of retries already scheduled runs on; restarting it from
+// every feed start would hold all feeds back again each time.
+void aml_dvb_tsdetect_kick(struct aml_dvb *dvb)
+{
+    struct aml_dvb_tsdetect *td = &dvb->tsdetect;
+
+    if (td->state != AML_TS_DETECT_PENDING ||
+        delayed_work_pending(&td->work))
+        return;
+
+    td->attempts = 0;
+    mod_delayed_work(system_wq, &td->work, 0);
+}
+EXPORT_SYMBOL(aml_dvb_tsdetect_kick);
+
+// Live change from sysfs: a fixed mode, or TS_MODE_AUTO to probe again
+int aml_dvb_tsdetect_set(struct aml_dvb *dvb, int mode, int clk_pol)
+{
+    struct aml_dvb_tsdetect *td = &dvb->tsdetect;
+    int ret;
+
+    if (mode < TS_MODE_AUTO || mode > TS_MODE_PARALLEL)
+        return -EINVAL;
+
+    ret = aml_dvb_pm_get(dvb);
+    if (ret)
+        return ret;
+
+    cancel_delayed_work_sync(&td->work);
+    td->probing = false;
+
+    dvb->ts_mode = mode;
+    if (clk_pol >= 0)
+        td->clk_pol = dvb->ts_clk_pol = !!clk_pol;
+
+    if (mode == TS_MODE_AUTO) {
+        td->state = AML_TS_DETECT_PENDING;
+        td->attempts = 0;
+        schedule_delayed_work(&td->work, 0);
+        aml_dvb_pm_put(dvb);
+        return 0;
+    }
+
+    // Restart the ring so no packets of the old format are delivered
+    mutex_lock(&dvb->dma_cfg_lock);
+    aml_dvb_dma_stop(dvb);
+    td->mode = mode;
+    td->state = AML_TS_DETECT_FIXED;
+    aml_dvb_reg_set_ts_input(dvb, td->mode, td->clk_pol);
+    aml_dmx_section_cache_flush(dvb);
+    aml_dvb_dma_start(dvb);
+    mutex_unlock(&dvb->dma_cfg_lock);
+    aml_dvb_pm_put(dvb);
+
+    dvb_info(dvb, "TS input set to %s, clock polarity %d\n",
+             aml_ts_mode_name(td->mode), td->clk_pol);
+    return 0;
+}
+EXPORT_SYMBOL(aml_dvb_tsdetect_set);
+
+// Settle the TS input configuration before the hardware is started
+void aml_dvb_tsdetect_init(struct aml_dvb *dvb)
+{
+    struct aml_dvb_tsdetect *td = &dvb->tsdetect;
+
+    INIT_DELAYED_WORK(&td->work, aml_dvb_tsdetect_work);
+
+    if (ts_mode >= TS_MODE_AUTO && ts_mode <= TS_MODE_PARALLEL)
+        dvb->ts_mode = ts_mode;
+    if (ts_clk_pol >= 0)
+        dvb->ts_clk_pol = !!ts_clk_pol;
+
+    // Until a probe succeeds, auto behaves as serial
+    td->mode = dvb->ts_mode == TS_MODE_PARALLEL ? TS_MODE_PARALLEL :
+                                                  TS_MODE_SERIAL;
+    td->clk_pol = dvb->ts_clk_pol;
+    td->state = dvb->ts_mode == TS_MODE_AUTO ? AML_TS_DETECT_PENDING :
+                                               AML_TS_DETECT_FIXED;
+}
+EXPORT_SYMBOL(aml_dvb_tsdetect_init);
+
+void aml_dvb_tsdetect_start(struct aml_dvb *dvb)
+{
+    struct aml_dvb_tsdetect *td = &dvb->tsdetect;
+
+    aml_dvb_reg_set_ts_input(dvb, td->mode, td->clk_pol);
+    dvb_info(dvb, "TS input: %s, clock polarity %d%s\n",
+             aml_ts_mode_name(td->mode), td->clk_pol,
+             td->state == AML_TS_DETECT_PENDING ? " (autodetect pending)" : "");
+}
+EXPORT_SYMBOL(aml_dvb_tsdetect_start);
+
+void aml_dvb_tsdetect_stop(struct aml_dvb *dvb)
+{
+    cancel_delayed_work_sync(&dvb->tsdetect.work);
+    dvb->tsdetect.probing = false;
+    dvb->tsdetect.counting = false;
+}
+EXPORT_SYMBOL(aml_dvb_tsdetect_stop);
+
+MODULE_DESCRIPTION("Amlogic DVB TS Input Autodetection");
+MODULE_LICENSE("GPL");
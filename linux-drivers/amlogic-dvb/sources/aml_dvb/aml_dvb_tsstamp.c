@@ -0,0 +1,110 @@
+// sources/aml_dvb/aml_dvb_tsstamp.c
+// Arrival timestamps: 192-byte timestamped TS output
+//
+// When enabled, raw TS feeds (dvr, TS tap) get a 4-byte M2TS-style
+// header in front of every packet: 2 copy-permission bits (zero) and a
+// 30-bit arrival time in 27 MHz ticks. The clock is sampled once per
+// DMA drain and interpolated across the packets of that drain, so
+// replay can be paced without re-parsing PCRs.
+
+#include <linux/module.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <asm/unaligned.h>
+#include "aml_dvb.h"
+
+#define AML_TS_ATS_MASK     GENMASK(29, 0)
+
+/* Longer gaps than this (100 ms) are idle time, not packet spacing */
+#define AML_TS_GAP_MAX      (27000000 / 10)
+
+static inline u64 aml_dvb_tsstamp_now(void)
+{
+    // 27 MHz ticks from the monotonic clock
+    return mul_u64_u32_div(ktime_get_ns(), 27, 1000);
+}
+
+// Start a new segment of @count packets; called from the DMA drain
+void aml_dvb_tsstamp_segment(struct aml_dvb *dvb, unsigned int count)
+{
+    struct aml_dvb_tsstamp *ts = &dvb->tsstamp;
+    u64 now = aml_dvb_tsstamp_now();
+
+    ts->start = ts->end && now - ts->end < AML_TS_GAP_MAX ? ts->end : now;
+    ts->end = now;
+    ts->count = count;
+    ts->chunk = NULL;
+}
+EXPORT_SYMBOL(aml_dvb_tsstamp_segment);
+
+// A contiguous part of the segment, starting at packet @first
+void aml_dvb_tsstamp_chunk(struct aml_dvb *dvb, const u8 *buf,
+                           unsigned int first, unsigned int count)
+{
+    struct aml_dvb_tsstamp *ts = &dvb->tsstamp;
+
+    ts->chunk = buf;
+    ts->chunk_first = first;
+    ts->chunk_len = count * TS_PACKET_SIZE;
+}
+EXPORT_SYMBOL(aml_dvb_tsstamp_chunk);
+
+// Interpolated arrival time of the packet at @pkt
+static u32 aml_dvb_tsstamp_of(struct aml_dvb_tsstamp *ts, const u8 *pkt)
+{
+    unsigned int i;
+
+    if (!ts->chunk || pkt < ts->chunk || pkt >= ts->chunk + ts->chunk_len ||
+        !ts->count)
+        return ts->end & AML_TS_ATS_MASK;
+
+    i = ts->chunk_first + (pkt - ts->chunk) / TS_PACKET_SIZE;
+
+    return (ts->start + div_u64((ts->end - ts->start) * (i + 1), ts->count)) &
+           AML_TS_ATS_MASK;
+}
+
+static int aml_dvb_tsstamp_cb(const u8 *buffer1, size_t buffer1_len,
+                              const u8 *buffer2, size_t buffer2_len,
+                              struct dmx_ts_feed *source, u32 *buffer_flags)
+{
+    struct dvb_demux_feed *feed = container_of(source, struct dvb_demux_feed,
+                                               feed.ts);
+    struct aml_dvb *dvb = feed->demux->priv;
+    dmx_ts_cb cb = dvb->tsstamp.cb[feed->index];
+    u8 hdr[4];
+
+    // dvb-core hands raw TS feeds one packet at a time
+    if (buffer1_len != TS_PACKET_SIZE || buffer2)
+        return cb(buffer1, buffer1_len, buffer2, buffer2_len, source,
+                  buffer_flags);
+
+    put_unaligned_be32(aml_dvb_tsstamp_of(&dvb->tsstamp, buffer1), hdr);
+
+    return cb(hdr, sizeof(hdr), buffer1, buffer1_len, source, buffer_flags);
+}
+
+// Raw TS feeds started while timestamping is on get 192-byte output
+void aml_dvb_tsstamp_start(struct aml_dvb *dvb, struct dvb_demux_feed *feed)
+{
+    if (!dvb->tsstamp.enable || !(feed->ts_type & TS_PACKET) ||
+        (feed->ts_type & TS_PAYLOAD_ONLY))
+        return;
+
+    dvb->tsstamp.cb[feed->index] = feed->cb.ts;
+    feed->cb.ts = aml_dvb_tsstamp_cb;
+}
+EXPORT_SYMBOL(aml_dvb_tsstamp_start);
+
+void aml_dvb_tsstamp_stop(struct aml_dvb *dvb, struct dvb_demux_feed *feed)
+{
+    if (!dvb->tsstamp.cb[feed->index])
+        return;
+
+    feed->cb.ts = dvb->tsstamp.cb[feed->index];
+    dvb->tsstamp.cb[feed->index] = NULL;
+}
+EXPORT_SYMBOL(aml_dvb_tsstamp_stop);
+
+MODULE_DESCRIPTION("Amlogic DVB TS Arrival Timestamps");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,85 @@
+// sources/aml_dvb/aml_dvb_variant.c
+// SoC variants: capabilities and register layout per demux generation
+//
+// Selected through the OF match data. GXBB/GXL/GXM share the original
+// block (256-entry PID banks, channels 4 KB apart); G12A/G12B/SM1 double
+// the PID table and move channels 8 KB apart; SC2 has four demux cores
+// with 1024 entries each. Every layout is checked against a model of
+// the register block at probe (aml_dvb_reg_layout_check), and all of
+// them can be checked on any board through sysfs hw_variants.
+
+#include <linux/module.h>
+#include <linux/sizes.h>
+#include "aml_dvb.h"
+
+#define AML_DVB_VARIANT(_type, _name, _pids, _secs, _inputs, _cores, _sg, \
+                        _max, _stride)                                  \
+    [_type] = {                                                         \
+        .type = _type,                                                  \
+        .name = _name,                                                  \
+        .pid_slots = _pids,                                             \
+        .sec_filters = _secs,                                           \
+        .ts_inputs = _inputs,                                           \
+        .demux_cores = _cores,                                          \
+        .dma_sg = _sg,                                                  \
+        .dma_timeout = true,                                            \
+        .dma_max = _max,                                                \
+        .pid_base = 0x100,                                              \
+        .chan_stride = _stride,                                         \
+        .reg_size = (_cores) * (_stride),                               \
+    }
+
+const struct aml_dvb_variant aml_dvb_variants[AML_DVB_HW_COUNT] = {
+    AML_DVB_VARIANT(AML_DVB_HW_GXBB, "gxbb", 256, 256, 3, 3, false,
+                    SZ_1M, 0x1000),
+    AML_DVB_VARIANT(AML_DVB_HW_GXL, "gxl", 256, 256, 3, 3, true,
+                    SZ_1M, 0x1000),
+    AML_DVB_VARIANT(AML_DVB_HW_GXM, "gxm", 256, 256, 3, 3, true,
+                    SZ_1M, 0x1000),
+    AML_DVB_VARIANT(AML_DVB_HW_G12A, "g12a", 512, 512, 4, 3, true,
+                    SZ_4M, 0x2000),
+    AML_DVB_VARIANT(AML_DVB_HW_G12B, "g12b", 512, 512, 4, 3, true,
+                    SZ_4M, 0x2000),
+    AML_DVB_VARIANT(AML_DVB_HW_SM1, "sm1", 512, 512, 4, 3, true,
+                    SZ_4M, 0x2000),
+    AML_DVB_VARIANT(AML_DVB_HW_SC2, "sc2", 1024, 1024, 4, 4, true,
+                    SZ_8M, 0x4000),
+};
+EXPORT_SYMBOL(aml_dvb_variants);
+
+// Probe: the variant's layout, and how many channels the mapping covers
+int aml_dvb_variant_init(struct aml_dvb *dvb, resource_size_t size)
+{
+    const struct aml_dvb_variant *v = dvb->variant;
+    u32 at;
+    int ret;
+
+    if (!v)
+        return -ENODEV;
+
+    ret = aml_dvb_reg_layout_check(v, &at);
+    if (ret) {
+        dvb_err(dvb, "%s register layout broken at 0x%x: %d\n", v->name,
+                at, ret);
+        return ret;
+    }
+
+    dvb->demux_cores = min_t(resource_size_t, v->demux_cores,
+                             size / v->chan_stride);
+    if (!dvb->demux_cores) {
+        dvb_err(dvb, "Register block of %pa bytes is too small for %s\n",
+                &size, v->name);
+        return -EINVAL;
+    }
+    if (dvb->demux_cores < v->demux_cores)
+        dvb_warn(dvb, "Register block covers %u of %u demux channels\n",
+                 dvb->demux_cores, v->demux_cores);
+
+    dvb_info(dvb, "%s: %u PID slots, %u demux channels, %u TS inputs\n",
+             v->name, v->pid_slots, dvb->demux_cores, v->ts_inputs);
+    return 0;
+}
+EXPORT_SYMBOL(aml_dvb_variant_init);
+
+MODULE_DESCRIPTION("Amlogic DVB SoC Variants");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,399 @@
+// sources/aml_dvb/aml_dvr_fanout.c
+// Shared capture fan-out: one kernel ring, many readers
+//
+// An extra dvr node on the adapter (numbered after the demux channels'
+// own) exposes the full TS leaving the primary DMA ring. Data is copied
+// into one shared ring per drain, whatever the number of readers; each
+// reader only keeps its own cursor. Readers use read() or mmap() the
+// ring read-only and move their cursor with AML_DVR_FANOUT_SYNC. A
+// reader that falls a whole ring behind gets -EOVERFLOW (or the
+// overflow flag) and is moved to the oldest data still held, instead
+// of being buffered separately. An open reader holds a runtime PM
+// reference, so the DMA ring keeps running under it, and bypasses the
+// PID filter so the ring carries the full TS, not just demux0's PIDs.
+//
+// The state is reference counted: open readers and live mappings keep
+// the ring after the adapter is removed, they just see no more data.
+
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <media/dvbdev.h>
+#include "aml_dvb.h"
+
+/* LCM of TS_PACKET_SIZE and PAGE_SIZE: ring offsets stay packet aligned */
+#define AML_FANOUT_UNIT     (47 * PAGE_SIZE)
+
+static unsigned int fanout_units = 16;
+module_param(fanout_units, uint, 0444);
+MODULE_PARM_DESC(fanout_units,
+                 "Shared fan-out ring size in units of 47 pages (~3 MB)");
+
+struct aml_dvr_fanout_reader {
+    struct aml_dvr_fanout *fo;
+    struct mutex lock;          /* read() and SYNC move the cursor */
+    u64 tail;                   /* absolute byte position */
+};
+
+static void aml_dvr_fanout_free(struct kref *ref)
+{
+    struct aml_dvr_fanout *fo = container_of(ref, struct aml_dvr_fanout, ref);
+
+    vfree(fo->ring);
+    kfree(fo);
+}
+
+// Producer side: called from the DMA drain, once per contiguous chunk
+void aml_dvr_fanout_write(struct aml_dvb *dvb, const u8 *buf, size_t len)
+{
+    struct aml_dvr_fanout *fo = dvb->fanout;
+    size_t off, n;
+
+    if (!fo || !atomic_read(&fo->readers))
+        return;
+
+    spin_lock(&fo->lock);
+    while (len) {
+        off = fo->head % fo->size;
+        n = min(len, fo->size - off);
+        memcpy(fo->ring + off, buf, n);
+        fo->head += n;
+        buf += n;
+        len -= n;
+    }
+    spin_unlock(&fo->lock);
+
+    wake_up_interruptible(&fo->wait);
+}
+EXPORT_SYMBOL(aml_dvr_fanout_write);
+
+static u64 aml_dvr_fanout_head(struct aml_dvr_fanout *fo)
+{
+    unsigned long flags;
+    u64 head;
+
+    spin_lock_irqsave(&fo->lock, flags);
+    head = fo->head;
+    spin_unlock_irqrestore(&fo->lock, flags);
+
+    return head;
+}
+
+// Pull a lagging reader up to the oldest data still in the ring
+static bool aml_dvr_fanout_catch_up(struct aml_dvr_fanout_reader *rd, u64 head)
+{
+    struct aml_dvr_fanout *fo = rd->fo;
+
+    if (head - rd->tail <= fo->size)
+        return false;
+
+    rd->tail = head - fo->size;
+    fo->overflows++;
+    return true;
+}
+
+static int aml_dvr_fanout_open(struct inode *inode, struct file *file)
+{
+    struct dvb_device *dvbdev = file->private_data;
+    struct aml_dvr_fanout *fo = dvbdev->priv;
+    struct aml_dvr_fanout_reader *rd;
+    int ret;
+
+    if ((file->f_flags & O_ACCMODE) != O_RDONLY)
+        return -EINVAL;
+
+    rd = kzalloc(sizeof(*rd), GFP_KERNEL);
+    if (!rd)
+        return -ENOMEM;
+    mutex_init(&rd->lock);
+
+    mutex_lock(&fo->open_lock);
+    if (!fo->dvb) {
+        ret = -ENODEV;
+        goto err_unlock;
+    }
+
+    // A reader keeps the block powered, as a running feed does
+    ret = aml_dvb_pm_get(fo->dvb);
+    if (ret)
+        goto err_unlock;
+    aml_dvb_pidset_pass_all(fo->dvb, true);
+
+    kref_get(&fo->ref);
+    rd->fo = fo;
+    rd->tail = aml_dvr_fanout_head(fo);
+    atomic_inc(&fo->readers);
+    mutex_unlock(&fo->open_lock);
+
+    file->private_data = rd;
+    return 0;
+
+err_unlock:
+    mutex_unlock(&fo->open_lock);
+    kfree(rd);
+    return ret;
+}
+
+static int aml_dvr_fanout_release(struct inode *inode, struct file *file)
+{
+    struct aml_dvr_fanout_reader *rd = file->private_data;
+    struct aml_dvr_fanout *fo = rd->fo;
+
+    // After teardown the exit path has already dropped our references
+    mutex_lock(&fo->open_lock);
+    if (fo->dvb) {
+        aml_dvb_pidset_pass_all(fo->dvb, false);
+        aml_dvb_pm_put(fo->dvb);
+    }
+    atomic_dec(&fo->readers);
+    mutex_unlock(&fo->open_lock);
+
+    kfree(rd);
+    kref_put(&fo->ref, aml_dvr_fanout_free);
+    return 0;
+}
+
+static ssize_t aml_dvr_fanout_read(struct file *file, char __user *buf,
+                                   size_t count, loff_t *ppos)
+{
+    struct aml_dvr_fanout_reader *rd = file->private_data;
+    struct aml_dvr_fanout *fo = rd->fo;
+    size_t done = 0, off, n;
+    u64 head, tail;
+    ssize_t ret;
+
+    if (mutex_lock_interruptible(&rd->lock))
+        return -ERESTARTSYS;
+
+    head = aml_dvr_fanout_head(fo);
+    while (head == rd->tail) {
+        // Adapter removed: nothing more will be written
+        if (!READ_ONCE(fo->dvb)) {
+            ret = -ENODEV;
+            goto out;
+        }
+        if (file->f_flags & O_NONBLOCK) {
+            ret = -EWOULDBLOCK;
+            goto out;
+        }
+        ret = wait_event_interruptible(fo->wait,
+                                       aml_dvr_fanout_head(fo) != rd->tail ||
+                                       !READ_ONCE(fo->dvb));
+        if (ret)
+            goto out;
+        head = aml_dvr_fanout_head(fo);
+    }
+
+    if (aml_dvr_fanout_catch_up(rd, head)) {
+        ret = -EOVERFLOW;
+        goto out;
+    }
+
+    tail = rd->tail;
+    count = min_t(u64, count, head - tail);
+    while (done < count) {
+        off = (tail + done) % fo->size;
+        n = min(count - done, fo->size - off);
+        if (copy_to_user(buf + done, fo->ring + off, n)) {
+            ret = -EFAULT;
+            goto out;
+        }
+        done += n;
+    }
+
+    // The producer may have lapped us while we were copying
+    if (aml_dvr_fanout_head(fo) - tail > fo->size) {
+        aml_dvr_fanout_catch_up(rd, aml_dvr_fanout_head(fo));
+        ret = -EOVERFLOW;
+        goto out;
+    }
+
+    rd->tail = tail + done;
+    ret = done;
+out:
+    mutex_unlock(&rd->lock);
+    return ret;
+}
+
+static __poll_t aml_dvr_fanout_poll(struct file *file, poll_table *wait)
+{
+    struct aml_dvr_fanout_reader *rd = file->private_data;
+    struct aml_dvr_fanout *fo = rd->fo;
+    u64 head;
+
+    poll_wait(file, &fo->wait, wait);
+
+    head = aml_dvr_fanout_head(fo);
+    if (!READ_ONCE(fo->dvb) && head == rd->tail)
+        return EPOLLHUP;
+    if (head - rd->tail > fo->size)
+        return EPOLLIN | EPOLLRDNORM | EPOLLERR;
+    if (head != rd->tail)
+        return EPOLLIN | EPOLLRDNORM;
+
+    return 0;
+}
+
+// mmap readers: report the window and advance the cursor in one call
+static long aml_dvr_fanout_ioctl(struct file *file, unsigned int cmd,
+                                 unsigned long arg)
+{
+    struct aml_dvr_fanout_reader *rd = file->private_data;
+    struct aml_dvr_fanout_sync sync;
+
+    if (cmd != AML_DVR_FANOUT_SYNC)
+        return -ENOTTY;
+
+    if (copy_from_user(&sync, (void __user *)arg, sizeof(sync)))
+        return -EFAULT;
+
+    mutex_lock(&rd->lock);
+
+    // Consume what the caller has processed since the last sync
+    if (sync.consumed)
+        rd->tail += min_t(u64, sync.consumed,
+                          aml_dvr_fanout_head(rd->fo) - rd->tail);
+
+    sync.head = aml_dvr_fanout_head(rd->fo);
+    sync.overflow = aml_dvr_fanout_catch_up(rd, sync.head);
+    sync.tail = rd->tail;
+    sync.size = rd->fo->size;
+    sync.consumed = 0;
+
+    mutex_unlock(&rd->lock);
+
+    if (copy_to_user((void __user *)arg, &sync, sizeof(sync)))
+        return -EFAULT;
+
+    return 0;
+}
+
+// A mapping pins the ring like an open reader does
+static void aml_dvr_fanout_vm_open(struct vm_area_struct *vma)
+{
+    struct aml_dvr_fanout *fo = vma->vm_private_data;
+
+    kref_get(&fo->ref);
+}
+
+static void aml_dvr_fanout_vm_close(struct vm_area_struct *vma)
+{
+    struct aml_dvr_fanout *fo = vma->vm_private_data;
+
+    kref_put(&fo->ref, aml_dvr_fanout_free);
+}
+
+static const struct vm_operations_struct aml_dvr_fanout_vm_ops = {
+    .open = aml_dvr_fanout_vm_open,
+    .close = aml_dvr_fanout_vm_close,
+};
+
+static int aml_dvr_fanout_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    struct aml_dvr_fanout_reader *rd = file->private_data;
+    int ret;
+
+    if (vma->vm_flags & VM_WRITE)
+        return -EPERM;
+    vm_flags_clear(vma, VM_MAYWRITE);
+
+    ret = remap_vmalloc_range(vma, rd->fo->ring, vma->vm_pgoff);
+    if (ret)
+        return ret;
+
+    // ->open is not called for the initial mapping
+    vma->vm_private_data = rd->fo;
+    vma->vm_ops = &aml_dvr_fanout_vm_ops;
+    aml_dvr_fanout_vm_open(vma);
+    return 0;
+}
+
+static const struct file_operations aml_dvr_fanout_fops = {
+    .owner = THIS_MODULE,
+    .open = aml_dvr_fanout_open,
+    .release = aml_dvr_fanout_release,
+    .read = aml_dvr_fanout_read,
+    .poll = aml_dvr_fanout_poll,
+    .unlocked_ioctl = aml_dvr_fanout_ioctl,
+    .compat_ioctl = compat_ptr_ioctl,
+    .mmap = aml_dvr_fanout_mmap,
+    .llseek = noop_llseek,
+};
+
+static const struct dvb_device aml_dvr_fanout_dev = {
+    .users = -1,
+    .readers = -1,
+    .writers = 1,
+    .fops = &aml_dvr_fanout_fops,
+};
+
+int aml_dvr_fanout_init(struct aml_dvb *dvb)
+{
+    struct aml_dvr_fanout *fo;
+    int ret;
+
+    fo = kzalloc(sizeof(*fo), GFP_KERNEL);
+    if (!fo)
+        return -ENOMEM;
+
+    kref_init(&fo->ref);
+    mutex_init(&fo->open_lock);
+    spin_lock_init(&fo->lock);
+    init_waitqueue_head(&fo->wait);
+    atomic_set(&fo->readers, 0);
+    fo->dvb = dvb;
+    fo->size = max(fanout_units, 1U) * AML_FANOUT_UNIT;
+
+    fo->ring = vmalloc_user(fo->size);
+    if (!fo->ring) {
+        kfree(fo);
+        return -ENOMEM;
+    }
+
+    ret = dvb_register_device(&dvb->adapter, &fo->dvbdev, &aml_dvr_fanout_dev,
+                              fo, DVB_DEVICE_DVR, 0);
+    if (ret) {
+        kref_put(&fo->ref, aml_dvr_fanout_free);
+        return ret;
+    }
+
+    dvb->fanout = fo;
+    dvb_info(dvb, "Fan-out dvr: %zu KB shared ring\n", fo->size / 1024);
+    return 0;
+}
+EXPORT_SYMBOL(aml_dvr_fanout_init);
+
+// Called with the DMA stopped. Readers still open keep the state alive
+// until they close; their PM and PID filter references go back now.
+void aml_dvr_fanout_exit(struct aml_dvb *dvb)
+{
+    struct aml_dvr_fanout *fo = dvb->fanout;
+    int i, readers;
+
+    if (!fo)
+        return;
+
+    // No new opens once this returns
+    dvb_unregister_device(fo->dvbdev);
+
+    mutex_lock(&fo->open_lock);
+    readers = atomic_read(&fo->readers);
+    for (i = 0; i < readers; i++) {
+        aml_dvb_pidset_pass_all(dvb, false);
+        aml_dvb_pm_put(dvb);
+    }
+    WRITE_ONCE(fo->dvb, NULL);
+    mutex_unlock(&fo->open_lock);
+
+    dvb->fanout = NULL;
+    wake_up_interruptible(&fo->wait);
+    kref_put(&fo->ref, aml_dvr_fanout_free);
+}
+EXPORT_SYMBOL(aml_dvr_fanout_exit);
+
+MODULE_DESCRIPTION("Amlogic DVB Shared DVR Fan-out");
+MODULE_LICENSE("GPL");